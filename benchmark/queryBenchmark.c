@@ -0,0 +1,563 @@
+/*
+********************************************************************************
+*
+* Filename     : queryBenchmark.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Load generator for the scanner's query server (--serve).
+********************************************************************************
+*/
+
+#define _GNU_SOURCE
+#include "../duplicateServer.h"
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Program name */
+#define PRGM_NAME   "queryBenchmark"
+
+/* Program usage */
+#define PRGM_USE    "Usage: " PRGM_NAME " [options]\n"\
+    "\t-s <path>     Server socket (default dsquery.sock)\n"\
+    "\t-c <n>        Concurrent clients (default 32)\n"\
+    "\t-p <n>        Requests each client keeps in flight (default 8)\n"\
+    "\t-d <s>        Seconds to run (default 5)\n"\
+    "\t-m <f:p:b>    Weights of find, prefix and batch requests (default 80:10:10)\n"\
+    "\t-b <n>        Names per batch request (default 16)\n"\
+    "\t-n <n>        Names to draw queries from (default 4096)\n"\
+    "\t-x <seed>     Random seed (default 1)\n"\
+    "\t-o <file>     Results file, CSV appended (default query_results.csv)\n"
+
+/* Header of the results file */
+#define CSV_HEADER  "timestamp,clients,depth,find,prefix,batch,batch_names,names,"\
+                    "seconds,requests,qps,p50_us,p99_us,p999_us,entries_per_s,errors\n"
+
+/* Characters the name pool is gathered with (as prefixes) */
+#define PREFIX_CHARS    "abcdefghijklmnopqrstuvwxyz0123456789_-.ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+
+/* Most requests a client keeps in flight, and request kinds measured */
+#define MAX_DEPTH   256
+#define KINDS       3
+
+/* Kinds measured, in the order of the -m weights */
+static const int kinds[KINDS] = {SERVER_FIND, SERVER_PREFIX, SERVER_BATCH};
+static const char *kindNames[KINDS] = {"find", "prefix", "batch"};
+
+/* A client connection */
+typedef struct {
+    int fd;
+    uint32_t nextId;
+    int inFlight, head;
+    long long sent[MAX_DEPTH];          // Send times, oldest at 'head'.
+    int kind[MAX_DEPTH];
+    char *input;
+    size_t inputUsed, inputCapacity;
+    char *output;
+    size_t outputStart, outputUsed, outputCapacity;
+} Connection;
+
+/* Latencies of one kind of request (nanoseconds) */
+typedef struct {
+    long long *samples;
+    long count, capacity;
+} Latencies;
+
+/* Run settings */
+typedef struct {
+    const char *socketPath;
+    int clients, depth, batchNames;
+    int weights[KINDS];
+    double seconds;
+} LoadSpec;
+
+/* Names and prefixes to query */
+static char **names;
+static long nameCount;
+
+/* Latencies per kind, entries received, and failed responses */
+static Latencies latencies[KINDS];
+static long long entriesReceived;
+static long errors;
+
+/*
+ ******************************************************************************
+ *                             Auxillary Functions
+ ******************************************************************************
+ */
+
+/* Returns the current monotonic time in nanoseconds */
+static long long monotonicNanos (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Grows a buffer to hold 'needed' bytes. Signals error with nonzero value */
+static int reserve (char **buffer, size_t *capacity, size_t needed) {
+    size_t size = *capacity ? *capacity : 4096;
+    char *grown;
+
+    if (needed <= *capacity) {
+        return 0;
+    }
+    while (size < needed) {
+        size *= 2;
+    }
+    if ((grown = realloc(*buffer, size)) == NULL) {
+        return 1;
+    }
+    *buffer = grown;
+    *capacity = size;
+    return 0;
+}
+
+/* Connects to the server. Returns the socket, or -1 */
+static int connectServer (const char *path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    int fd;
+
+    if (strlen(path) >= sizeof(address.sun_path) ||
+        (fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1) {
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Sends a request and reads its response into '*payload' (blocking). Returns
+ * the status, or -1 on error */
+static int exchange (int fd, int kind, const char *request, uint32_t length,
+                     char **payload, size_t *capacity) {
+    ServerHeader header = {length, 0, kind, 0, 0};
+    size_t done;
+    ssize_t n;
+
+    if (write(fd, &header, sizeof(header)) != sizeof(header) ||
+        (length > 0 && write(fd, request, length) != (ssize_t)length)) {
+        return -1;
+    }
+    for (done = 0; done < sizeof(header); done += n) {
+        if ((n = read(fd, (char *)&header + done, sizeof(header) - done)) <= 0) {
+            return -1;
+        }
+    }
+    if (reserve(payload, capacity, header.length)) {
+        return -1;
+    }
+    for (done = 0; done < header.length; done += n) {
+        if ((n = read(fd, *payload + done, header.length - done)) <= 0) {
+            return -1;
+        }
+    }
+    return header.status;
+}
+
+/* Fills the name pool from prefix queries, one per character. Signals error
+ * with nonzero value */
+static int gatherNames (const char *path, long wanted) {
+    long perPrefix = wanted / (sizeof(PREFIX_CHARS) - 1) + 1;
+    char *payload = NULL;
+    size_t capacity = 0;
+    int fd = connectServer(path);
+
+    if (fd == -1) {
+        fprintf(stderr, "Error: Can't connect to %s!\n", path);
+        return 1;
+    }
+    if ((names = malloc(wanted * sizeof(char *))) == NULL) {
+        close(fd);
+        return 1;
+    }
+    for (const char *c = PREFIX_CHARS; *c != '\0' && nameCount < wanted; c++) {
+        uint32_t entries;
+        size_t at = sizeof(uint32_t);
+        long taken = 0;
+        int status = exchange(fd, SERVER_PREFIX, c, 1, &payload, &capacity);
+
+        if (status != SERVER_OK && status != SERVER_TRUNCATED) {
+            continue;
+        }
+        memcpy(&entries, payload, sizeof(entries));
+
+        // Take a few names per prefix, so every prefix is represented.
+        for (uint32_t i = 0; i < entries && taken < perPrefix && nameCount < wanted; i++) {
+            char path[MAX_PATH], *name;
+            uint16_t length;
+
+            memcpy(&length, payload + at + 16, sizeof(length));
+            memcpy(path, payload + at + SERVER_ENTRY, length);
+            path[length] = '\0';
+            name = strrchr(path, '/');
+            name = name != NULL ? name + 1 : path;
+            if ((nameCount == 0 || strcmp(names[nameCount - 1], name) != 0) &&
+                (names[nameCount] = strdup(name)) != NULL) {
+                nameCount++;
+                taken++;
+            }
+            at += SERVER_ENTRY + length;
+        }
+    }
+    free(payload);
+    close(fd);
+    return nameCount == 0;
+}
+
+/* Records a latency sample of kind 'k'. Signals error with nonzero value */
+static int addLatency (int k, long long nanos) {
+    Latencies *l = &latencies[k];
+
+    if (l->count == l->capacity) {
+        long capacity = l->capacity ? 2 * l->capacity : 65536;
+        long long *samples = realloc(l->samples, capacity * sizeof(long long));
+        if (samples == NULL) {
+            return 1;
+        }
+        l->samples = samples;
+        l->capacity = capacity;
+    }
+    l->samples[l->count++] = nanos;
+    return 0;
+}
+
+/* Orders latencies */
+static int compareNanos (const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/* Returns quantile 'q' of sorted samples, in microseconds */
+static double quantile (const long long *samples, long count, double q) {
+    return count > 0 ? samples[(long)(q * (count - 1))] / 1e3 : 0;
+}
+
+/*
+ ******************************************************************************
+ *                                Load Loop
+ ******************************************************************************
+ */
+
+/* Picks a request kind by weight */
+static int pickKind (const LoadSpec *spec) {
+    int total = spec->weights[0] + spec->weights[1] + spec->weights[2];
+    int r = (int)(drand48() * total);
+
+    for (int k = 0; k < KINDS; k++) {
+        if ((r -= spec->weights[k]) < 0) {
+            return k;
+        }
+    }
+    return 0;
+}
+
+/* Queues a random request. Signals error with nonzero value */
+static int queueRequest (const LoadSpec *spec, Connection *c) {
+    int k = pickKind(spec), slot = (c->head + c->inFlight) % MAX_DEPTH;
+    ServerHeader header = {0, c->nextId++, kinds[k], 0, 0};
+    size_t at = c->outputUsed;
+
+    if (reserve(&c->output, &c->outputCapacity,
+                at + sizeof(header) + (size_t)spec->batchNames * (NAME_MAX + 1))) {
+        return 1;
+    }
+    at += sizeof(header);
+    if (k == 0) {
+        const char *name = names[(long)(drand48() * nameCount)];
+        header.length = strlen(name);
+        memcpy(c->output + at, name, header.length);
+    } else if (k == 1) {
+        // Two characters of a name: a few names' worth of files.
+        const char *name = names[(long)(drand48() * nameCount)];
+        header.length = name[1] != '\0' ? 2 : 1;
+        memcpy(c->output + at, name, header.length);
+    } else {
+        for (int i = 0; i < spec->batchNames; i++) {
+            const char *name = names[(long)(drand48() * nameCount)];
+            size_t length = strlen(name) + 1;
+            memcpy(c->output + at + header.length, name, length);
+            header.length += length;
+        }
+    }
+    memcpy(c->output + c->outputUsed, &header, sizeof(header));
+    c->outputUsed = at + header.length;
+    c->sent[slot] = monotonicNanos();
+    c->kind[slot] = k;
+    c->inFlight++;
+    return 0;
+}
+
+/* Sends queued requests. Signals error with nonzero value */
+static int sendRequests (Connection *c) {
+    while (c->outputStart < c->outputUsed) {
+        ssize_t n = send(c->fd, c->output + c->outputStart, c->outputUsed - c->outputStart,
+                         MSG_NOSIGNAL);
+        if (n > 0) {
+            c->outputStart += n;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else if (errno != EINTR) {
+            return 1;
+        }
+    }
+    c->outputStart = c->outputUsed = 0;
+    return 0;
+}
+
+/* Counts the entries of a response payload */
+static long countEntries (int kind, const char *payload, uint32_t length) {
+    long entries = 0;
+
+    for (size_t at = 0; kind != SERVER_COUNTS && at + sizeof(uint32_t) <= length; ) {
+        uint32_t count;
+        memcpy(&count, payload + at, sizeof(count));
+        at += sizeof(count);
+        for (uint32_t i = 0; i < count && at + SERVER_ENTRY <= length; i++) {
+            uint16_t pathLength;
+            memcpy(&pathLength, payload + at + 16, sizeof(pathLength));
+            at += SERVER_ENTRY + pathLength;
+            entries++;
+        }
+    }
+    return entries;
+}
+
+/* Reads responses and records their latencies. Signals error with nonzero value */
+static int readResponses (Connection *c) {
+    size_t at = 0;
+    ssize_t n;
+
+    for (;;) {
+        if (reserve(&c->input, &c->inputCapacity, c->inputUsed + 65536)) {
+            return 1;
+        }
+        if ((n = read(c->fd, c->input + c->inputUsed, c->inputCapacity - c->inputUsed)) > 0) {
+            c->inputUsed += n;
+        } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            return 1;
+        } else {
+            break;
+        }
+    }
+    while (c->inputUsed - at >= sizeof(ServerHeader)) {
+        long long now = monotonicNanos();
+        ServerHeader header;
+
+        memcpy(&header, c->input + at, sizeof(header));
+        if (c->inputUsed - at < sizeof(header) + header.length) {
+            break;
+        }
+        if (c->inFlight == 0 || header.id != c->nextId - c->inFlight ||
+            (header.status != SERVER_OK && header.status != SERVER_TRUNCATED)) {
+            errors++;
+        }
+        if (c->inFlight > 0) {
+            int k = c->kind[c->head];
+            if (addLatency(k, now - c->sent[c->head])) {
+                return 1;
+            }
+            entriesReceived += countEntries(kinds[k], c->input + at + sizeof(header),
+                                            header.length);
+            c->head = (c->head + 1) % MAX_DEPTH;
+            c->inFlight--;
+        }
+        at += sizeof(header) + header.length;
+    }
+    memmove(c->input, c->input + at, c->inputUsed - at);
+    c->inputUsed -= at;
+    return 0;
+}
+
+/* Runs the load. Returns the seconds it took, or -1 on error */
+static double runLoad (const LoadSpec *spec) {
+    Connection *connections = calloc(spec->clients, sizeof(Connection));
+    struct epoll_event events[64];
+    int poller = epoll_create1(EPOLL_CLOEXEC), failed = poller == -1 || connections == NULL;
+    long long start = monotonicNanos(), end = start + (long long)(spec->seconds * 1e9);
+    long long stopped;
+
+    for (int i = 0; !failed && i < spec->clients; i++) {
+        Connection *c = &connections[i];
+        if ((c->fd = connectServer(spec->socketPath)) == -1) {
+            fprintf(stderr, "Error: Can't connect client %d!\n", i);
+            failed = 1;
+            break;
+        }
+        fcntl(c->fd, F_SETFL, O_NONBLOCK);
+        failed = epoll_ctl(poller, EPOLL_CTL_ADD, c->fd,
+                           &(struct epoll_event){EPOLLIN | EPOLLOUT | EPOLLET, {.ptr = c}}) == -1;
+    }
+
+    // Each client keeps 'depth' requests in flight until time is up, then drains.
+    for (int draining = 0; !failed; ) {
+        long inFlight = 0;
+        int n;
+
+        draining = monotonicNanos() >= end;
+        for (int i = 0; i < spec->clients; i++) {
+            Connection *c = &connections[i];
+            while (!draining && c->inFlight < spec->depth && !failed) {
+                failed = queueRequest(spec, c);
+            }
+            failed |= sendRequests(c);
+            inFlight += c->inFlight;
+        }
+        if (draining && inFlight == 0) {
+            break;
+        }
+        if ((n = epoll_wait(poller, events, 64, 100)) == -1 && errno != EINTR) {
+            failed = 1;
+        }
+        for (int i = 0; i < n && !failed; i++) {
+            Connection *c = events[i].data.ptr;
+            if (events[i].events & EPOLLIN) {
+                failed = readResponses(c);
+            }
+        }
+    }
+    stopped = monotonicNanos();
+
+    for (int i = 0; connections != NULL && i < spec->clients; i++) {
+        if (connections[i].fd > 0) {
+            close(connections[i].fd);
+        }
+        free(connections[i].input);
+        free(connections[i].output);
+    }
+    free(connections);
+    if (poller != -1) {
+        close(poller);
+    }
+    return failed ? -1 : (stopped - start) / 1e9;
+}
+
+/* Prints (and appends to 'resultsPath') the results. Signals error with nonzero value */
+static int report (const LoadSpec *spec, double seconds, const char *resultsPath) {
+    long long *all;
+    long total = 0;
+    FILE *out;
+    int header;
+
+    for (int k = 0; k < KINDS; k++) {
+        total += latencies[k].count;
+    }
+    if ((all = malloc((total + 1) * sizeof(long long))) == NULL) {
+        return 1;
+    }
+    fprintf(stdout, "%s: %d clients, %d in flight each, %.1f s, %ld names\n", PRGM_NAME,
+            spec->clients, spec->depth, seconds, nameCount);
+    total = 0;
+    for (int k = 0; k < KINDS; k++) {
+        Latencies *l = &latencies[k];
+        qsort(l->samples, l->count, sizeof(long long), compareNanos);
+        memcpy(all + total, l->samples, l->count * sizeof(long long));
+        total += l->count;
+        if (l->count > 0) {
+            fprintf(stdout, "  %-7s %9ld requests, p50 %8.1f us, p99 %8.1f us\n", kindNames[k],
+                    l->count, quantile(l->samples, l->count, 0.5),
+                    quantile(l->samples, l->count, 0.99));
+        }
+    }
+    qsort(all, total, sizeof(long long), compareNanos);
+    fprintf(stdout, "  all     %9ld requests, p50 %8.1f us, p99 %8.1f us, p99.9 %8.1f us\n",
+            total, quantile(all, total, 0.5), quantile(all, total, 0.99),
+            quantile(all, total, 0.999));
+    fprintf(stdout, "  %.0f requests/s, %.0f entries/s, %ld errors\n", total / seconds,
+            entriesReceived / seconds, errors);
+
+    // Append to the results file, writing the header if it's new.
+    header = access(resultsPath, F_OK) != 0;
+    if ((out = fopen(resultsPath, "a")) == NULL) {
+        fprintf(stderr, "Error: Can't open results file %s!\n", resultsPath);
+        free(all);
+        return 1;
+    }
+    if (header) {
+        fputs(CSV_HEADER, out);
+    }
+    fprintf(out, "%ld,%d,%d,%d,%d,%d,%d,%ld,%.3f,%ld,%.0f,%.1f,%.1f,%.1f,%.0f,%ld\n",
+            (long)time(NULL), spec->clients, spec->depth, spec->weights[0], spec->weights[1],
+            spec->weights[2], spec->batchNames, nameCount, seconds, total, total / seconds,
+            quantile(all, total, 0.5), quantile(all, total, 0.99), quantile(all, total, 0.999),
+            entriesReceived / seconds, errors);
+    fclose(out);
+    free(all);
+    return 0;
+}
+
+/*
+ ******************************************************************************
+ *                                    Main
+ ******************************************************************************
+ */
+
+int main (int argc, char *argv[]) {
+    LoadSpec spec = {"dsquery.sock", 32, 8, 16, {80, 10, 10}, 5};
+    const char *resultsPath = "query_results.csv";
+    long wanted = 4096, seed = 1;
+    double seconds;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:c:p:d:m:b:n:x:o:h")) != -1) {
+        switch (opt) {
+            case 's': spec.socketPath = optarg; break;
+            case 'c': spec.clients = atoi(optarg); break;
+            case 'p': spec.depth = atoi(optarg); break;
+            case 'd': spec.seconds = atof(optarg); break;
+            case 'm':
+                if (sscanf(optarg, "%d:%d:%d", &spec.weights[0], &spec.weights[1],
+                           &spec.weights[2]) != 3) {
+                    fprintf(stderr, "Error: Bad weights %s!\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'b': spec.batchNames = atoi(optarg); break;
+            case 'n': wanted = atol(optarg); break;
+            case 'x': seed = atol(optarg); break;
+            case 'o': resultsPath = optarg; break;
+            default:
+                fprintf(stdout, "%s", PRGM_USE);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (spec.clients < 1 || spec.depth < 1 || spec.depth > MAX_DEPTH || spec.batchNames < 1 ||
+        spec.seconds <= 0 || wanted < 1 || spec.weights[0] < 0 || spec.weights[1] < 0 ||
+        spec.weights[2] < 0 || spec.weights[0] + spec.weights[1] + spec.weights[2] == 0) {
+        fprintf(stderr, "Error: Invalid parameters!\n%s", PRGM_USE);
+        return EXIT_FAILURE;
+    }
+    srand48(seed);
+
+    if (gatherNames(spec.socketPath, wanted)) {
+        fprintf(stderr, "Error: Couldn't get names to query from %s!\n", spec.socketPath);
+        return EXIT_FAILURE;
+    }
+    if ((seconds = runLoad(&spec)) < 0) {
+        fprintf(stderr, "Error: The load failed!\n");
+        return EXIT_FAILURE;
+    }
+    if (report(&spec, seconds, resultsPath)) {
+        return EXIT_FAILURE;
+    }
+    for (long i = 0; i < nameCount; i++) {
+        free(names[i]);
+    }
+    free(names);
+    for (int k = 0; k < KINDS; k++) {
+        free(latencies[k].samples);
+    }
+    return EXIT_SUCCESS;
+}
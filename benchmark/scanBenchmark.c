@@ -0,0 +1,502 @@
+/*
+********************************************************************************
+*
+* Filename     : scanBenchmark.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Generates synthetic file trees and benchmarks the scanner.
+********************************************************************************
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Program name */
+#define PRGM_NAME   "scanBenchmark"
+
+/* Program usage */
+#define PRGM_USE    "Usage: " PRGM_NAME " [options]\n"\
+    "\t-r <dir>      Root of the generated tree (default /dev/shm/dsbench). Must\n"\
+    "\t              be new, empty or generated here before\n"\
+    "\t-b <path>     Scanner binary (default ./duplicateScanner)\n"\
+    "\t-a <option>   Extra scanner option (such as --pipeline=1,4,1)\n"\
+    "\t-o <file>     Results file, CSV appended (default bench_results.csv)\n"\
+    "\t-d <n>        Tree depth (default 3)\n"\
+    "\t-f <n>        Sub-directories per directory (default 8)\n"\
+    "\t-n <n>        Files per directory (default 64)\n"\
+    "\t-u <ratio>    Fraction of names drawn from the shared pool (default 0.3)\n"\
+    "\t-p <n>        Size of the shared name pool (default 1024)\n"\
+    "\t-l <min:max>  Name length range (default 8:24)\n"\
+    "\t-s <min:max>  File size range in bytes (default 0:4096)\n"\
+    "\t-i <n>        Iterations per tree (default 3)\n"\
+    "\t-x <seed>     Random seed (default 1)\n"\
+    "\t-R            Skip the report phase (scan only)\n"\
+    "\t-S            Count system calls (runs the scanner under strace -c)\n"\
+    "\t-k            Keep the generated tree afterwards\n"\
+    "\t-g            Only generate the tree, don't run the scanner\n"
+
+/* The maximum length of a generated path */
+#define MAX_PATH    4096
+
+/* File marking the root of a generated tree: only marked trees are removed */
+#define TREE_MARKER ".scanBenchmark"
+
+/* Alphabet used when generating file names */
+#define NAME_CHARS  "abcdefghijklmnopqrstuvwxyz0123456789_-"
+
+/* Header of the results file */
+#define CSV_HEADER  "timestamp,depth,fanout,files_per_dir,dup_ratio,pool,"\
+                    "name_min,name_max,size_min,size_max,files,dirs,"\
+                    "iteration,report,wall_s,files_per_s,user_s,sys_s,"\
+                    "max_rss_kb,syscalls\n"
+
+/* Tree generation parameters */
+typedef struct {
+    int depth, fanout, filesPerDir, poolSize;
+    double dupRatio;
+    int nameMin, nameMax;
+    long sizeMin, sizeMax;
+} TreeSpec;
+
+/* Counts of generated objects */
+typedef struct {
+    long files, dirs;
+} TreeCount;
+
+/* Measurements of a single scanner run */
+typedef struct {
+    double wall, user, sys;
+    long maxRSS, syscalls;
+} RunResult;
+
+/*
+ ******************************************************************************
+ *                             Auxillary Functions
+ ******************************************************************************
+ */
+
+/* Returns a uniformly distributed integer in [lo, hi] */
+static long randomRange (long lo, long hi) {
+    if (hi <= lo) {
+        return lo;
+    }
+    return lo + (long)(drand48() * (double)(hi - lo + 1));
+}
+
+/* Writes a random name of random length within spec bounds into buffer */
+static void randomName (const TreeSpec *spec, char *buffer) {
+    int length = (int)randomRange(spec->nameMin, spec->nameMax);
+
+    for (int i = 0; i < length; i++) {
+        buffer[i] = NAME_CHARS[randomRange(0, sizeof(NAME_CHARS) - 2)];
+    }
+    buffer[length] = '\0';
+}
+
+/* Returns the current monotonic time in seconds */
+static double monotonicTime (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Parses a "min:max" range argument. Signals error with nonzero value */
+static int parseRange (const char *arg, long *min, long *max) {
+    char *end;
+
+    *min = strtol(arg, &end, 10);
+    if (*end != ':') {
+        return 1;
+    }
+    *max = strtol(end + 1, &end, 10);
+    return (*end != '\0' || *max < *min);
+}
+
+/*
+ ******************************************************************************
+ *                             Tree Generation
+ ******************************************************************************
+ */
+
+/* Recursively populates directory 'path'. Signals error with nonzero value */
+static int generateTree (const TreeSpec *spec, char **pool, const char *path,
+                         int depth, TreeCount *count) {
+    char childPath[MAX_PATH], name[MAX_PATH];
+
+    if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+        fprintf(stderr, "Error: Can't create directory %s!\n", path);
+        return 1;
+    }
+    count->dirs++;
+
+    // Mark the root first, so even a partly generated tree can be removed. The
+    // scanner tracks the marker too, so it counts as a file.
+    if (depth == 0) {
+        int fd;
+        snprintf(childPath, MAX_PATH, "%s/%s", path, TREE_MARKER);
+        if ((fd = open(childPath, O_WRONLY | O_CREAT, 0644)) == -1) {
+            fprintf(stderr, "Error: Can't create marker %s!\n", childPath);
+            return 1;
+        }
+        close(fd);
+        count->files++;
+    }
+
+    // Create the files of this directory.
+    for (int i = 0; i < spec->filesPerDir; i++) {
+        int fd;
+
+        // Shared names produce duplicates across directories.
+        if (drand48() < spec->dupRatio) {
+            snprintf(name, sizeof(name), "%s", pool[randomRange(0, spec->poolSize - 1)]);
+        } else {
+            randomName(spec, name);
+        }
+
+        if (snprintf(childPath, MAX_PATH, "%s/%s", path, name) >= MAX_PATH) {
+            continue;
+        }
+        if ((fd = open(childPath, O_WRONLY | O_CREAT | O_EXCL, 0644)) == -1) {
+            continue;
+        }
+        if (ftruncate(fd, randomRange(spec->sizeMin, spec->sizeMax)) == -1) {
+            fprintf(stderr, "Error: Can't size file %s!\n", childPath);
+        }
+        close(fd);
+        count->files++;
+    }
+
+    // Descend into sub-directories.
+    if (depth >= spec->depth) {
+        return 0;
+    }
+    for (int i = 0; i < spec->fanout; i++) {
+        snprintf(childPath, MAX_PATH, "%s/d%d", path, i);
+        if (generateTree(spec, pool, childPath, depth + 1, count)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Returns nonzero if 'path' is the root of a generated tree */
+static int isGenerated (const char *path) {
+    char markerPath[MAX_PATH];
+    struct stat info;
+
+    snprintf(markerPath, MAX_PATH, "%s/%s", path, TREE_MARKER);
+    return lstat(markerPath, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+/* nftw callback: removes an entry, directories after their contents */
+static int removeEntry (const char *path, const struct stat *info, int type,
+                        struct FTW *walk) {
+    (void)info;
+    (void)walk;
+    if (unlinkat(AT_FDCWD, path, type == FTW_DP ? AT_REMOVEDIR : 0) == -1) {
+        fprintf(stderr, "Error: Couldn't remove %s!\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+/* Removes the generated tree at 'path' (nothing else). Signals error with nonzero value */
+static int removeTree (const char *path) {
+    if (!isGenerated(path)) {
+        fprintf(stderr, "Error: %s isn't a generated tree, not removing it!\n", path);
+        return 1;
+    }
+    return nftw(path, removeEntry, 64, FTW_DEPTH | FTW_PHYS) != 0;
+}
+
+/* Readies 'path' for generation: a generated tree there is removed, an empty
+ * directory is used as is, anything else is refused. Signals error with nonzero value */
+static int prepareRoot (const char *path) {
+    struct stat info;
+    struct dirent *entry;
+    int empty = 1;
+    DIR *directory;
+
+    if (lstat(path, &info) == -1) {
+        if (errno != ENOENT) {
+            fprintf(stderr, "Error: Can't check %s!\n", path);
+            return 1;
+        }
+        return 0;
+    }
+    if (S_ISDIR(info.st_mode) && isGenerated(path)) {
+        return removeTree(path);
+    }
+    if (S_ISDIR(info.st_mode) && (directory = opendir(path)) != NULL) {
+        while (empty && (entry = readdir(directory)) != NULL) {
+            empty = strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0;
+        }
+        closedir(directory);
+        if (empty) {
+            return 0;
+        }
+    }
+    fprintf(stderr, "Error: %s exists and wasn't generated by %s! Choose another -r\n",
+            path, PRGM_NAME);
+    return 1;
+}
+
+/*
+ ******************************************************************************
+ *                             Scanner Execution
+ ******************************************************************************
+ */
+
+/* Reads the total call count from an strace -c summary file */
+static long readSyscallCount (const char *summaryPath) {
+    char line[512];
+    long calls = -1;
+    FILE *summary;
+
+    if ((summary = fopen(summaryPath, "r")) == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), summary) != NULL) {
+        double pct, seconds;
+        long usecs;
+
+        if (strstr(line, "total") != NULL) {
+            sscanf(line, "%lf %lf %ld %ld", &pct, &seconds, &usecs, &calls);
+        }
+    }
+    fclose(summary);
+    return calls;
+}
+
+/* Runs the scanner over 'root'. Signals error with nonzero value */
+static int runScanner (const char *binary, const char *extra, const char *root, int report,
+                       int countSyscalls, RunResult *result) {
+    const char *script = report ? "a\nq\n" : "q\n";
+    char summaryPath[] = "/tmp/scanBenchmark.XXXXXX";
+    struct rusage usage;
+    int input[2], status, fd = -1;
+    double start;
+    pid_t pid;
+
+    if (countSyscalls && (fd = mkstemp(summaryPath)) == -1) {
+        return 1;
+    }
+    if (pipe(input) == -1) {
+        return 1;
+    }
+
+    start = monotonicTime();
+    if ((pid = fork()) == -1) {
+        return 1;
+    }
+
+    // Child: menu input from the pipe, output discarded.
+    if (pid == 0) {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(input[0], STDIN_FILENO);
+        dup2(devNull, STDOUT_FILENO);
+        dup2(devNull, STDERR_FILENO);
+        close(input[0]);
+        close(input[1]);
+        // The extra option (if any) goes before the root.
+        char *arguments[] = {"strace", "-f", "-c", "-o", summaryPath, (char *)binary,
+                             (char *)(extra != NULL ? extra : root), (char *)root, NULL};
+        if (extra == NULL) {
+            arguments[7] = NULL;
+        }
+        if (countSyscalls) {
+            execvp("strace", arguments);
+        } else {
+            execv(binary, arguments + 5);
+        }
+        _exit(127);
+    }
+
+    // Parent: feed the menu, then wait for completion.
+    close(input[0]);
+    if (write(input[1], script, strlen(script)) == -1) {
+        fprintf(stderr, "Error: Couldn't drive the scanner menu!\n");
+    }
+    close(input[1]);
+
+    if (wait4(pid, &status, 0, &usage) == -1 || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Error: Scanner run failed!\n");
+        return 1;
+    }
+
+    result->wall = monotonicTime() - start;
+    result->user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    result->sys = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    result->maxRSS = usage.ru_maxrss;
+    result->syscalls = -1;
+
+    if (countSyscalls) {
+        result->syscalls = readSyscallCount(summaryPath);
+        close(fd);
+        unlink(summaryPath);
+    }
+    return 0;
+}
+
+/* Appends a result line to the results file. Signals error with nonzero value */
+static int recordResult (const char *resultsPath, const TreeSpec *spec,
+                         const TreeCount *count, int iteration, int report,
+                         const RunResult *result) {
+    FILE *results;
+    long position;
+
+    if ((results = fopen(resultsPath, "a")) == NULL) {
+        fprintf(stderr, "Error: Can't open results file %s!\n", resultsPath);
+        return 1;
+    }
+
+    // Emit the header for new files.
+    fseek(results, 0, SEEK_END);
+    if ((position = ftell(results)) == 0) {
+        fputs(CSV_HEADER, results);
+    }
+
+    fprintf(results, "%ld,%d,%d,%d,%.3f,%d,%d,%d,%ld,%ld,%ld,%ld,%d,%d,"
+            "%.6f,%.1f,%.6f,%.6f,%ld,%ld\n",
+            (long)time(NULL), spec->depth, spec->fanout, spec->filesPerDir,
+            spec->dupRatio, spec->poolSize, spec->nameMin, spec->nameMax,
+            spec->sizeMin, spec->sizeMax, count->files, count->dirs,
+            iteration, report, result->wall, count->files / result->wall,
+            result->user, result->sys, result->maxRSS, result->syscalls);
+
+    fclose(results);
+    return 0;
+}
+
+/*
+ ******************************************************************************
+ *                                    Main
+ ******************************************************************************
+ */
+
+/* Main: Generates a tree, scans it repeatedly and records the results */
+int main (int argc, char *argv[]) {
+    TreeSpec spec = {3, 8, 64, 1024, 0.3, 8, 24, 0, 4096};
+    const char *root = "/dev/shm/dsbench", *binary = "./duplicateScanner", *extra = NULL;
+    const char *resultsPath = "bench_results.csv";
+    int iterations = 3, report = 1, countSyscalls = 0, keep = 0, generateOnly = 0;
+    long seed = 1, lo, hi;
+    TreeCount count = {0, 0};
+    char **pool;
+    int option;
+
+    while ((option = getopt(argc, argv, "r:b:a:o:d:f:n:u:p:l:s:i:x:RSkgh")) != -1) {
+        switch (option) {
+            case 'r': root = optarg; break;
+            case 'b': binary = optarg; break;
+            case 'a': extra = optarg; break;
+            case 'o': resultsPath = optarg; break;
+            case 'd': spec.depth = atoi(optarg); break;
+            case 'f': spec.fanout = atoi(optarg); break;
+            case 'n': spec.filesPerDir = atoi(optarg); break;
+            case 'u': spec.dupRatio = atof(optarg); break;
+            case 'p': spec.poolSize = atoi(optarg); break;
+            case 'i': iterations = atoi(optarg); break;
+            case 'x': seed = atol(optarg); break;
+            case 'R': report = 0; break;
+            case 'S': countSyscalls = 1; break;
+            case 'k': keep = 1; break;
+            case 'g': generateOnly = keep = 1; break;
+            case 'l':
+                if (parseRange(optarg, &lo, &hi) || lo < 1 || hi > 255) {
+                    fprintf(stderr, "Error: Bad name length range %s!\n", optarg);
+                    return -1;
+                }
+                spec.nameMin = (int)lo;
+                spec.nameMax = (int)hi;
+                break;
+            case 's':
+                if (parseRange(optarg, &spec.sizeMin, &spec.sizeMax) || spec.sizeMin < 0) {
+                    fprintf(stderr, "Error: Bad file size range %s!\n", optarg);
+                    return -1;
+                }
+                break;
+            default:
+                fprintf(stdout, "%s", PRGM_USE);
+                return option == 'h' ? 0 : -1;
+        }
+    }
+
+    if (spec.poolSize < 1 || spec.depth < 0 || spec.fanout < 0 || spec.filesPerDir < 0) {
+        fprintf(stderr, "Error: Bad tree parameters!\n%s", PRGM_USE);
+        return -1;
+    }
+
+    // Build the shared name pool.
+    srand48(seed);
+    if ((pool = malloc(spec.poolSize * sizeof(char *))) == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < spec.poolSize; i++) {
+        if ((pool[i] = malloc(spec.nameMax + 1)) == NULL) {
+            return -1;
+        }
+        randomName(&spec, pool[i]);
+    }
+
+    // Generate the tree, replacing only one generated before.
+    if (prepareRoot(root)) {
+        return -1;
+    }
+    fprintf(stdout, "%s: Generating tree at %s\n", PRGM_NAME, root);
+    if (generateTree(&spec, pool, root, 0, &count)) {
+        return -1;
+    }
+    fprintf(stdout, "%s: Generated %ld files in %ld directories\n", PRGM_NAME,
+            count.files, count.dirs);
+
+    // Run the scanner (first iteration also warms the dentry cache).
+    for (int i = 0; !generateOnly && i < iterations; i++) {
+        RunResult result;
+
+        if (runScanner(binary, extra, root, report, countSyscalls, &result)) {
+            return -1;
+        }
+        fprintf(stdout, "%s: Run %d: %.3fs, %.0f files/s, %ld KiB peak RSS",
+                PRGM_NAME, i, result.wall, count.files / result.wall, result.maxRSS);
+        if (result.syscalls >= 0) {
+            fprintf(stdout, ", %ld syscalls", result.syscalls);
+        }
+        putchar('\n');
+
+        if (recordResult(resultsPath, &spec, &count, i, report, &result)) {
+            return -1;
+        }
+    }
+
+    // Clean up.
+    if (!keep && removeTree(root)) {
+        return -1;
+    }
+    for (int i = 0; i < spec.poolSize; i++) {
+        free(pool[i]);
+    }
+    free(pool);
+
+    return 0;
+}
@@ -0,0 +1,654 @@
+/*
+********************************************************************************
+*
+* Filename     : trackerBenchmark.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Microbenchmarks the tracker's hash, insert and lookup paths.
+********************************************************************************
+*/
+
+#define _GNU_SOURCE
+#include "../duplicateTracker.h"
+#include "../duplicateKernels.h"
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Program name */
+#define PRGM_NAME   "trackerBenchmark"
+
+/* Program usage */
+#define PRGM_USE    "Usage: " PRGM_NAME " [options]\n"\
+    "\t-n <n>      Files inserted per distribution (default 1000000)\n"\
+    "\t-q <n>      Lookups per distribution (default 10000)\n"\
+    "\t-z <s>      Zipf exponent of the duplicate distribution (default 1.0)\n"\
+    "\t-k <n>      Distinct names for the Zipf distribution (default 100000)\n"\
+    "\t-c <n>      Buckets targeted by the collision distribution (default 64)\n"\
+    "\t-a <n>      Files in the collision distribution (default 20000)\n"\
+    "\t-t <n>      Threads sharing a tracker in the concurrent runs (default 4)\n"\
+    "\t-x <seed>   Random seed (default 1)\n"
+
+/* Low hash bits the collision distribution pins (covers every table size used) */
+#define COLLIDE_BITS    20
+
+/* Records a concurrent inserter buffers before merging them */
+#define INSERT_BATCH    256
+
+/* Upper bounds of the chain length histogram classes */
+#define HIST_CLASSES    8
+static const long histBounds[HIST_CLASSES] = {0, 1, 2, 4, 8, 16, 64, -1};
+
+/* Name/mtime/size stream */
+typedef struct {
+    const char *label;
+    char **names;
+    time_t *modified;
+    uint64_t *sizes;
+    long count;
+} Stream;
+
+/* A thread's share of a concurrent run */
+typedef struct {
+    const Stream *stream;
+    Tracker *tracker;
+    pthread_mutex_t *lock;
+    long first, last;
+    int failed;
+} Inserter;
+
+/* A reader querying a tracker while it is filled */
+typedef struct {
+    const Stream *stream;
+    TrackerReader *reader;
+    atomic_int *inserting;
+    long queries, files;
+    double nanos;
+} Snapshots;
+
+/* Cache miss counter (perf_event_open), or -1 if unavailable */
+static int missCounter = -1;
+
+/*
+ ******************************************************************************
+ *                             Auxillary Functions
+ ******************************************************************************
+ */
+
+/* Returns the current monotonic time in nanoseconds */
+static double monotonicNanos (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Opens a hardware cache miss counter for this thread, if permitted */
+static void openMissCounter (void) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    missCounter = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Resets and starts the cache miss counter */
+static void startMissCounter (void) {
+    if (missCounter != -1) {
+        ioctl(missCounter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(missCounter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+/* Stops the cache miss counter, returns the count or -1 */
+static long stopMissCounter (void) {
+    long long misses;
+
+    if (missCounter == -1) {
+        return -1;
+    }
+    ioctl(missCounter, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(missCounter, &misses, sizeof(misses)) != sizeof(misses)) {
+        return -1;
+    }
+    return (long)misses;
+}
+
+/* Returns a random name in the form "<prefix><number>.dat" */
+static char *makeName (const char *prefix, long number) {
+    char buffer[NAME_MAX + 1];
+    snprintf(buffer, sizeof(buffer), "%s%ld.dat", prefix, number);
+    return strdup(buffer);
+}
+
+/*
+ ******************************************************************************
+ *                             Stream Generation
+ ******************************************************************************
+ */
+
+/* Allocates a stream of 'count' entries */
+static int newStream (Stream *s, const char *label, long count) {
+    s->label = label;
+    s->count = count;
+    s->names = calloc(count, sizeof(char *));
+    s->modified = malloc(count * sizeof(time_t));
+    s->sizes = malloc(count * sizeof(uint64_t));
+
+    if (s->names == NULL || s->modified == NULL || s->sizes == NULL) {
+        return 1;
+    }
+    for (long i = 0; i < count; i++) {
+        s->modified[i] = (time_t)(1500000000 + lrand48() % 100000000);
+        s->sizes[i] = lrand48() % 65536;
+    }
+    return 0;
+}
+
+/* Frees a stream */
+static void freeStream (Stream *s) {
+    for (long i = 0; i < s->count; i++) {
+        free(s->names[i]);
+    }
+    free(s->names);
+    free(s->modified);
+    free(s->sizes);
+}
+
+/* All names distinct */
+static int uniqueStream (Stream *s, long count) {
+    if (newStream(s, "unique", count)) {
+        return 1;
+    }
+    for (long i = 0; i < count; i++) {
+        s->names[i] = makeName("file", i);
+    }
+    return 0;
+}
+
+/* Names drawn from 'keys' distinct names with Zipf(exponent) frequencies */
+static int zipfStream (Stream *s, long count, long keys, double exponent) {
+    double *cdf, total = 0.0;
+
+    if (newStream(s, "zipf", count) || (cdf = malloc(keys * sizeof(double))) == NULL) {
+        return 1;
+    }
+    for (long k = 0; k < keys; k++) {
+        cdf[k] = (total += 1.0 / pow(k + 1, exponent));
+    }
+
+    // Inverse transform sampling by binary search over the CDF.
+    for (long i = 0; i < count; i++) {
+        double u = drand48() * total;
+        long lo = 0, hi = keys - 1;
+        while (lo < hi) {
+            long mid = (lo + hi) / 2;
+            if (cdf[mid] < u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        s->names[i] = makeName("zipf", lo);
+    }
+
+    free(cdf);
+    return 0;
+}
+
+/* Distinct names whose hashes all reduce into one of 'buckets' table slots */
+static int collisionStream (Stream *s, long count, long buckets) {
+    long found = 0, candidate = 0;
+
+    if (newStream(s, "collide", count)) {
+        return 1;
+    }
+    while (found < count) {
+        char buffer[NAME_MAX + 1];
+        snprintf(buffer, sizeof(buffer), "c%ld.dat", candidate++);
+        if ((trackerHash(buffer) & ((1UL << COLLIDE_BITS) - 1)) < (uint64_t)buckets) {
+            s->names[found++] = strdup(buffer);
+        }
+    }
+    return 0;
+}
+
+/*
+ ******************************************************************************
+ *                                Measurement
+ ******************************************************************************
+ */
+
+/* Measures raw trackerHash() throughput over the stream */
+static double benchHash (const Stream *s) {
+    volatile long sink = 0;
+    double start = monotonicNanos();
+
+    for (long i = 0; i < s->count; i++) {
+        sink += trackerHash(s->names[i]);
+    }
+    return (monotonicNanos() - start) / s->count;
+}
+
+/* Adds a file's path length to the total at 'context' */
+static int sumPathBytes (void *context, const FileView *file) {
+    *(uint64_t *)context += file->directoryLength + 1 + file->nameLength;
+    return 0;
+}
+
+/* Prints bytes stored per path and the path decoding throughput */
+static void printPathStore (Tracker *t) {
+    uint64_t raw, stored, decoded = 0;
+    double start, seconds;
+
+    trackerPathUsage(t, &raw, &stored);
+    start = monotonicNanos();
+    if (trackerIterate(t, sumPathBytes, &decoded) < 0) {
+        fprintf(stderr, "Error: Couldn't decode the paths!\n");
+        return;
+    }
+    seconds = (monotonicNanos() - start) / 1e9;
+    fprintf(stdout, "	paths: %.1f bytes stored per path (%.1f raw), decode %.0f MB/s\n",
+            (double)stored / trackerFileCount(t), (double)raw / trackerFileCount(t),
+            decoded / seconds / 1e6);
+}
+
+/* Returns ns per file of one pass over every group and member */
+static double timeIteration (Tracker *t) {
+    TrackerIterator it;
+    GroupView group;
+    FileView file;
+    volatile uint64_t sink = 0;
+    double start = monotonicNanos();
+
+    trackerBegin(t, NULL, &it);
+    while (trackerNextGroup(&it, &group)) {
+        while (trackerNextMember(&it, &file)) {
+            sink += file.modified;
+        }
+    }
+    return (monotonicNanos() - start) / trackerFileCount(t);
+}
+
+/* Returns ns per file of filtering every group by size (visiting passing members if asked) */
+static double timeFilter (Tracker *t, int members) {
+    TrackerFilter filter = {2, 4096, 0, 0};
+    TrackerIterator it;
+    GroupView group;
+    FileView file;
+    volatile uint64_t sink = 0;
+    double start = monotonicNanos();
+
+    trackerBegin(t, &filter, &it);
+    while (trackerNextGroup(&it, &group)) {
+        sink += group.bytes;
+        while (members && trackerNextMember(&it, &file)) {
+            sink += file.size;
+        }
+    }
+    return (monotonicNanos() - start) / trackerFileCount(t);
+}
+
+/* Prints full-table iteration costs: the first pass, a repeat and filtered passes */
+static void printIteration (Tracker *t) {
+    double first = timeIteration(t), again = timeIteration(t);
+
+    fprintf(stdout, "\titerate (%s kernels): %.1f ns/file first pass, %.1f ns/file again, "
+            "%.1f ns/file filter only, %.1f ns/file filtered members\n", kernelName(), first,
+            again, timeFilter(t, 0), timeFilter(t, 1));
+}
+
+/* Prints ns per group of the report in each order (written to /dev/null) */
+static void printReportOrders (Tracker *t) {
+    static const char *names[] = {"table", "name", "count", "wasted", "newest"};
+    FILE *out = fopen("/dev/null", "w");
+
+    if (out == NULL) {
+        return;
+    }
+    fprintf(stdout, "\treport:");
+    for (ReportOrder order = ORDER_TABLE; order <= ORDER_NEWEST; order++) {
+        double start = monotonicNanos();
+        trackerPrintSorted(t, NULL, order, out);
+        fprintf(stdout, " %s %.1f", names[order],
+                (monotonicNanos() - start) / trackerGroupCount(t));
+    }
+    fprintf(stdout, " ns/group\n");
+    fclose(out);
+}
+
+/* Inserts a share of the stream one file at a time, locking per file */
+static void *insertEach (void *context) {
+    Inserter *in = context;
+    char path[MAX_PATH];
+
+    for (long i = in->first; i < in->last; i++) {
+        snprintf(path, MAX_PATH, "/bench/dir%ld/%s", (i / 64) & 1023, in->stream->names[i]);
+        pthread_mutex_lock(in->lock);
+        in->failed |= trackerInsert(in->tracker, path, in->stream->modified[i],
+                                    in->stream->sizes[i]);
+        pthread_mutex_unlock(in->lock);
+    }
+    return NULL;
+}
+
+/* Inserts a share of the stream through a local buffer, locking per batch */
+static void *insertBatched (void *context) {
+    Inserter *in = context;
+    TrackerRecord records[INSERT_BATCH];
+    char (*text)[MAX_PATH + NAME_MAX + 1] = malloc(INSERT_BATCH * sizeof(*text));
+    char buffer[NAME_MAX + 1];
+    long n = 0;
+
+    if (text == NULL) {
+        in->failed = 1;
+        return NULL;
+    }
+    for (long i = in->first; i < in->last; i++) {
+        TrackerRecord *record = &records[n];
+        char *path = text[n];
+
+        // Keys that aren't the file name are kept after the path.
+        record->pathLength = snprintf(path, MAX_PATH, "/bench/dir%ld/%s", (i / 64) & 1023,
+                                      in->stream->names[i]);
+        record->path = path;
+        record->modified = in->stream->modified[i];
+        record->size = in->stream->sizes[i];
+        if (trackerPrepare(in->tracker, record, buffer)) {
+            in->failed = 1;
+            continue;
+        }
+        if (record->key == buffer) {
+            record->key = memcpy(path + record->pathLength + 1, buffer, record->keyLength + 1);
+        }
+
+        if (++n == INSERT_BATCH || i + 1 == in->last) {
+            pthread_mutex_lock(in->lock);
+            in->failed |= trackerInsertBatch(in->tracker, records, n) != 0;
+            pthread_mutex_unlock(in->lock);
+            n = 0;
+        }
+    }
+    free(text);
+    return NULL;
+}
+
+/* Returns ns per file of 'threads' threads inserting the stream into one tracker, or -1 */
+static double timeConcurrent (const Stream *s, int threads, void *(*insert)(void *)) {
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_t workers[threads];
+    Inserter shares[threads];
+    int started[threads], failed = 0;
+    double start;
+    Tracker *t;
+
+    if ((t = trackerCreate(NULL)) == NULL) {
+        return -1;
+    }
+    start = monotonicNanos();
+    for (int i = 0; i < threads; i++) {
+        shares[i] = (Inserter){s, t, &lock, s->count * i / threads,
+                               s->count * (i + 1) / threads, 0};
+        if (!(started[i] = pthread_create(&workers[i], NULL, insert, &shares[i]) == 0)) {
+            insert(&shares[i]);
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(workers[i], NULL);
+        }
+        failed |= shares[i].failed;
+    }
+    start = monotonicNanos() - start;
+
+    failed |= trackerFileCount(t) != s->count;
+    trackerDestroy(t);
+    return failed ? -1 : start / s->count;
+}
+
+/* Prints the cost of per-file and batched inserts from 'threads' threads */
+static void printConcurrent (const Stream *s, int threads) {
+    double each = timeConcurrent(s, threads, insertEach);
+    double batched = timeConcurrent(s, threads, insertBatched);
+
+    if (each < 0 || batched < 0) {
+        fprintf(stdout, "\tconcurrent: failed\n");
+        return;
+    }
+    fprintf(stdout, "\tconcurrent (%d threads): per-file %.1f ns/file, batched %.1f ns/file "
+            "(%.2fx)\n", threads, each, batched, each / batched);
+}
+
+/* Counts the files a snapshot query visits */
+static int countFile (void *context, const FileView *file) {
+    (void)file;
+    (*(long *)context)++;
+    return 0;
+}
+
+/* Queries random names of the stream until the inserts are done */
+static void *querySnapshots (void *context) {
+    Snapshots *q = context;
+    unsigned short state[3] = {1, 2, 3};
+    double start = monotonicNanos();
+
+    while (atomic_load_explicit(q->inserting, memory_order_relaxed)) {
+        const char *name = q->stream->names[nrand48(state) % q->stream->count];
+        if (trackerReaderQuery(q->reader, name, countFile, &q->files) < 0) {
+            break;
+        }
+        q->queries++;
+    }
+    q->nanos = monotonicNanos() - start;
+    return NULL;
+}
+
+/* Prints the cost of inserting the stream while another thread queries it */
+static void printSnapshots (const Stream *s) {
+    char path[MAX_PATH];
+    atomic_int inserting = 1;
+    Snapshots q = {s, NULL, &inserting, 0, 0, 0.0};
+    pthread_t thread;
+    double start, insertNs;
+    Tracker *t;
+
+    if ((t = trackerCreate(NULL)) == NULL || (q.reader = trackerReaderCreate(t)) == NULL ||
+        pthread_create(&thread, NULL, querySnapshots, &q) != 0) {
+        fprintf(stdout, "\tsnapshots: failed\n");
+        trackerReaderDestroy(q.reader);
+        trackerDestroy(t);
+        return;
+    }
+    start = monotonicNanos();
+    for (long i = 0; i < s->count; i++) {
+        snprintf(path, MAX_PATH, "/bench/dir%ld/%s", (i / 64) & 1023, s->names[i]);
+        trackerInsert(t, path, s->modified[i], s->sizes[i]);
+    }
+    insertNs = (monotonicNanos() - start) / s->count;
+    atomic_store(&inserting, 0);
+    pthread_join(thread, NULL);
+
+    fprintf(stdout, "\tsnapshots: insert %.1f ns/file beside a reader, %.1f us/query "
+            "(%ld queries, %.1f files each)\n", insertNs,
+            q.queries ? q.nanos / q.queries / 1e3 : 0.0, q.queries,
+            q.queries ? (double)q.files / q.queries : 0.0);
+    trackerReaderDestroy(q.reader);
+    trackerDestroy(t);
+}
+
+/* Orders name pointers by name */
+static int compareNames (const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* Prints the chain length histogram the stream's names produce in the table */
+static void printChainHistogram (const Stream *s, long buckets) {
+    long *chains = calloc(buckets, sizeof(long));
+    long classes[HIST_CLASSES] = {0}, maxChain = 0;
+    char **names = malloc(s->count * sizeof(char *));
+
+    if (chains == NULL || names == NULL) {
+        free(chains);
+        free(names);
+        return;
+    }
+
+    // Chains link one group per distinct name.
+    memcpy(names, s->names, s->count * sizeof(char *));
+    qsort(names, s->count, sizeof(char *), compareNames);
+    for (long i = 0; i < s->count; i++) {
+        if (i == 0 || strcmp(names[i - 1], names[i]) != 0) {
+            chains[trackerHash(names[i]) & (buckets - 1)]++;
+        }
+    }
+    for (long b = 0; b < buckets; b++) {
+        int c = 0;
+        while (histBounds[c] != -1 && chains[b] > histBounds[c]) {
+            c++;
+        }
+        classes[c]++;
+        maxChain = chains[b] > maxChain ? chains[b] : maxChain;
+    }
+
+    fprintf(stdout, "\tchains: ");
+    for (int c = 0; c < HIST_CLASSES; c++) {
+        if (histBounds[c] == -1) {
+            fprintf(stdout, ">%ld:%ld", histBounds[c - 1], classes[c]);
+        } else {
+            fprintf(stdout, "<=%ld:%ld ", histBounds[c], classes[c]);
+        }
+    }
+    fprintf(stdout, " (max %ld, %ld buckets)\n", maxChain, buckets);
+    free(chains);
+    free(names);
+}
+
+/* Inserts, then looks up the stream. Signals error with nonzero value */
+static int benchStream (const Stream *s, long lookups, int threads) {
+    char path[MAX_PATH];
+    double start, insertNs, lookupNs;
+    long insertMisses, lookupMisses;
+    volatile long sink = 0;
+    Tracker *t;
+
+    if ((t = trackerCreate(NULL)) == NULL) {
+        return 1;
+    }
+
+    // Insert in scan order: runs of 64 files share a directory.
+    startMissCounter();
+    start = monotonicNanos();
+    for (long i = 0; i < s->count; i++) {
+        snprintf(path, MAX_PATH, "/bench/dir%ld/%s", (i / 64) & 1023, s->names[i]);
+        if (trackerInsert(t, path, s->modified[i], s->sizes[i])) {
+            fprintf(stderr, "Error: Couldn't insert %s!\n", path);
+            stopMissCounter();
+            trackerDestroy(t);
+            return 1;
+        }
+    }
+    insertNs = (monotonicNanos() - start) / s->count;
+    insertMisses = stopMissCounter();
+
+    // Lookups only resolve the group, they don't visit its files.
+    startMissCounter();
+    start = monotonicNanos();
+    for (long i = 0; i < lookups; i++) {
+        sink += trackerQuery(t, s->names[lrand48() % s->count], NULL, NULL);
+    }
+    lookupNs = (monotonicNanos() - start) / (lookups ? lookups : 1);
+    lookupMisses = stopMissCounter();
+
+    fprintf(stdout, "%-8s hash %7.1f ns   insert %8.1f ns   lookup %10.1f ns",
+            s->label, benchHash(s), insertNs, lookupNs);
+    if (insertMisses >= 0) {
+        fprintf(stdout, "   misses/insert %.2f   misses/lookup %.2f",
+                (double)insertMisses / s->count, (double)lookupMisses / lookups);
+    }
+    putchar('\n');
+    printChainHistogram(s, trackerBucketCount(t));
+    printPathStore(t);
+    printIteration(t);
+    printReportOrders(t);
+    printConcurrent(s, threads);
+    printSnapshots(s);
+
+    trackerDestroy(t);
+    return 0;
+}
+
+/*
+ ******************************************************************************
+ *                                    Main
+ ******************************************************************************
+ */
+
+/* Main: Runs every distribution through the tracker */
+int main (int argc, char *argv[]) {
+    long count = 1000000, lookups = 10000, keys = 100000, buckets = 64;
+    long collisions = 20000;
+    double exponent = 1.0;
+    long seed = 1;
+    int threads = 4;
+    Stream s;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:q:z:k:c:a:t:x:h")) != -1) {
+        switch (option) {
+            case 'n': count = atol(optarg); break;
+            case 'q': lookups = atol(optarg); break;
+            case 'z': exponent = atof(optarg); break;
+            case 'k': keys = atol(optarg); break;
+            case 'c': buckets = atol(optarg); break;
+            case 'a': collisions = atol(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'x': seed = atol(optarg); break;
+            default:
+                fprintf(stdout, "%s", PRGM_USE);
+                return option == 'h' ? 0 : -1;
+        }
+    }
+    if (count < 1 || keys < 1 || buckets < 1 || collisions < 1 || lookups < 0 ||
+        threads < 1) {
+        fprintf(stderr, "Error: Bad parameters!\n%s", PRGM_USE);
+        return -1;
+    }
+
+    srand48(seed);
+    openMissCounter();
+    if (missCounter == -1) {
+        fprintf(stdout, "%s: Cache miss counters unavailable\n", PRGM_NAME);
+    }
+
+    if (uniqueStream(&s, count) || benchStream(&s, lookups, threads)) {
+        return -1;
+    }
+    freeStream(&s);
+
+    if (zipfStream(&s, count, keys, exponent) || benchStream(&s, lookups, threads)) {
+        return -1;
+    }
+    freeStream(&s);
+
+    // Colliding chains make insertion quadratic, so this stream is smaller.
+    if (collisionStream(&s, collisions, buckets) || benchStream(&s, lookups, threads)) {
+        return -1;
+    }
+    freeStream(&s);
+
+    return 0;
+}
@@ -0,0 +1,270 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateCheckpoint.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Incremental checkpoint journal for resuming interrupted scans.
+********************************************************************************
+*/
+
+#include "duplicateCheckpoint.h"
+#include "duplicateStatistics.h"
+#include <unistd.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Journal signature and format version */
+#define JOURNAL_MAGIC   "DSJOURN"
+#define JOURNAL_VERSION 1
+
+/* Segment types */
+#define SEG_RECORD      'R'     // int64 mtime, uint64 size, uint16 length, path
+#define SEG_FRONTIER    'F'     // uint64 count, then count x (uint16 length, path)
+#define SEG_COMMIT      'C'     // uint64 records journaled so far
+
+/*
+ * The journal is append-only: every tracked file is written as a record, and a
+ * checkpoint appends the pending directories and a commit marker, then syncs.
+ * Each checkpoint therefore costs the records since the previous one plus the
+ * frontier. Whatever follows the last commit is discarded on resume; the
+ * directories those records came from are still in the committed frontier.
+ */
+
+/* Journal file header (fields are stored in host byte order) */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+} JournalHeader;
+
+/* The open journal */
+static FILE *journal;
+
+/* Records journaled, checkpoint interval and when the next one is due (monotonic ns) */
+static uint64_t records;
+static long interval;
+static long long nextCheckpoint;
+
+/*
+ ******************************************************************************
+ *                             Auxillary Functions
+ ******************************************************************************
+ */
+
+/* Reads a length prefixed path into 'buffer'. Signals error with nonzero value */
+static int readPath (FILE *in, char buffer[MAX_PATH]) {
+    uint16_t length;
+
+    if (fread(&length, sizeof(length), 1, in) != 1 || length >= MAX_PATH ||
+        fread(buffer, 1, length, in) != length) {
+        return 1;
+    }
+    buffer[length] = '\0';
+    return 0;
+}
+
+/* Writes a length prefixed path. Signals error with nonzero value */
+static int writePath (FILE *out, const char *path) {
+    uint16_t length = strlen(path);
+
+    return fwrite(&length, sizeof(length), 1, out) != 1 ||
+           fwrite(path, 1, length, out) != length;
+}
+
+/* Returns the offset just past the last commit of 'in' (0 if none) */
+static long lastCommit (FILE *in) {
+    char path[MAX_PATH];
+    long commit = 0;
+    int type;
+
+    while ((type = fgetc(in)) != EOF) {
+        uint64_t count, size;
+        int64_t modified;
+
+        if (type == SEG_RECORD) {
+            if (fread(&modified, sizeof(modified), 1, in) != 1 ||
+                fread(&size, sizeof(size), 1, in) != 1 || readPath(in, path)) {
+                break;
+            }
+        } else if (type == SEG_FRONTIER) {
+            if (fread(&count, sizeof(count), 1, in) != 1) {
+                break;
+            }
+            while (count-- > 0 && readPath(in, path) == 0)
+                ;
+            if (count != (uint64_t)-1) {
+                break;
+            }
+        } else if (type == SEG_COMMIT && fread(&count, sizeof(count), 1, in) == 1) {
+            commit = ftell(in);
+        } else {
+            break;
+        }
+    }
+    return commit;
+}
+
+/* Replays 'in' up to offset 'end'. Signals error with nonzero value */
+static int replay (FILE *in, long end, Tracker *t, int (*restore)(const char *)) {
+    char path[MAX_PATH], **frontier = NULL;
+    long frontierCount = 0;
+    int status = 0;
+
+    while (status == 0 && ftell(in) < end) {
+        int type = fgetc(in);
+        uint64_t count, size;
+        int64_t modified;
+
+        if (type == SEG_RECORD) {
+            status = fread(&modified, sizeof(modified), 1, in) != 1 ||
+                     fread(&size, sizeof(size), 1, in) != 1 || readPath(in, path) ||
+                     trackerInsert(t, path, (time_t)modified, size);
+            records++;
+        } else if (type == SEG_FRONTIER) {
+
+            // Only the frontier of the last checkpoint matters.
+            for (long i = 0; i < frontierCount; i++) {
+                free(frontier[i]);
+            }
+            free(frontier);
+            frontier = NULL;
+            frontierCount = 0;
+
+            if (fread(&count, sizeof(count), 1, in) != 1 ||
+                (count > 0 && (frontier = malloc(count * sizeof(char *))) == NULL)) {
+                status = 1;
+                break;
+            }
+            for (; frontierCount < (long)count; frontierCount++) {
+                if (readPath(in, path) || (frontier[frontierCount] = strdup(path)) == NULL) {
+                    status = 1;
+                    break;
+                }
+            }
+        } else {
+            status = type != SEG_COMMIT || fread(&count, sizeof(count), 1, in) != 1;
+        }
+    }
+
+    // Restore bottom up so the directory stack comes back in order.
+    for (long i = 0; i < frontierCount; i++) {
+        if (status == 0) {
+            status = restore(frontier[i]);
+        }
+        free(frontier[i]);
+    }
+    free(frontier);
+    return status;
+}
+
+/*
+ ******************************************************************************
+ *                             Public Functions
+ ******************************************************************************
+ */
+
+/* Opens the journal, replaying its last checkpoint when resuming */
+int checkpointOpen (const char *path, int resume, long seconds, Tracker *t,
+                    int (*restore)(const char *directoryName), int *resumed) {
+    JournalHeader header = {JOURNAL_MAGIC, JOURNAL_VERSION, 0};
+    long commit = 0;
+
+    *resumed = 0;
+    records = 0;
+    interval = seconds > 0 ? seconds : CHECKPOINT_INTERVAL;
+
+    // Find the last commit of an existing journal.
+    if (resume && (journal = fopen(path, "r+b")) != NULL) {
+        JournalHeader existing;
+        if (fread(&existing, sizeof(existing), 1, journal) == 1 &&
+            memcmp(existing.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0 &&
+            existing.version == JOURNAL_VERSION) {
+            commit = lastCommit(journal);
+        }
+        if (commit > 0) {
+            fseek(journal, sizeof(JournalHeader), SEEK_SET);
+            if (replay(journal, commit, t, restore)) {
+                fclose(journal);
+                return 1;
+            }
+
+            // Drop the uncommitted tail and continue appending after the commit.
+            if (fflush(journal) != 0 || ftruncate(fileno(journal), commit) != 0 ||
+                fseek(journal, commit, SEEK_SET) != 0) {
+                fclose(journal);
+                return 1;
+            }
+            *resumed = 1;
+        } else {
+            fclose(journal);
+        }
+    }
+
+    // Otherwise start a new journal.
+    if (!*resumed) {
+        if ((journal = fopen(path, "wb")) == NULL ||
+            fwrite(&header, sizeof(header), 1, journal) != 1) {
+            return 1;
+        }
+    }
+
+    nextCheckpoint = statsNanos() + interval * 1000000000LL;
+    return 0;
+}
+
+/* Journals a tracked file. Signals error with nonzero value */
+int checkpointRecord (const char *filePath, time_t modified, uint64_t size) {
+    int64_t mtime = modified;
+
+    if (journal == NULL) {
+        return 0;
+    }
+    records++;
+    return fputc(SEG_RECORD, journal) == EOF ||
+           fwrite(&mtime, sizeof(mtime), 1, journal) != 1 ||
+           fwrite(&size, sizeof(size), 1, journal) != 1 || writePath(journal, filePath);
+}
+
+/* Returns nonzero if the next checkpoint is due */
+int checkpointDue (void) {
+    return journal != NULL && statsNanos() >= nextCheckpoint;
+}
+
+/* Commits the records so far with the pending directories */
+int checkpointCommit (char * const *frontier, long count) {
+    uint64_t n = count;
+    long long start = statsNanos(), cost, period = interval * 1000000000LL;
+    int status;
+
+    if (journal == NULL) {
+        return 0;
+    }
+
+    status = fputc(SEG_FRONTIER, journal) == EOF ||
+             fwrite(&n, sizeof(n), 1, journal) != 1;
+    for (long i = 0; i < count && status == 0; i++) {
+        status = writePath(journal, frontier[i]);
+    }
+    status = status || fputc(SEG_COMMIT, journal) == EOF ||
+             fwrite(&records, sizeof(records), 1, journal) != 1 ||
+             fflush(journal) != 0 || fsync(fileno(journal)) != 0;
+
+    // Keep checkpoints a small fraction of scan time.
+    cost = statsNanos() - start;
+    nextCheckpoint = start + cost + (cost * CHECKPOINT_COST_RATIO > period ?
+                                     cost * CHECKPOINT_COST_RATIO : period);
+    return status;
+}
+
+/* Closes the journal */
+void checkpointClose (void) {
+    if (journal != NULL) {
+        fclose(journal);
+        journal = NULL;
+    }
+}
@@ -0,0 +1,55 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateCheckpoint.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Incremental checkpoint journal for resuming interrupted scans.
+********************************************************************************
+*/
+
+#include "duplicateTracker.h"
+
+#if !defined(duplicateCheckpoint_h)
+#define duplicateCheckpoint_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Default minimum seconds between checkpoints */
+#define CHECKPOINT_INTERVAL     60
+
+/* Checkpoints are spaced at least this many times their own cost apart */
+#define CHECKPOINT_COST_RATIO   50
+
+/*
+ ******************************************************************************
+ *                                  Prototypes
+ ******************************************************************************
+ */
+
+ /*
+  * Opens the journal at 'path', checkpointing at most every 'interval' seconds.
+  * With 'resume', replays the records of its last committed checkpoint into 't',
+  * passes each directory of its frontier to 'restore' and sets '*resumed';
+  * without a usable checkpoint it starts over. Signals error with nonzero value.
+  */
+ int checkpointOpen (const char *path, int resume, long interval, Tracker *t,
+                     int (*restore)(const char *directoryName), int *resumed);
+
+ /* Journals a tracked file. Signals error with nonzero value */
+ int checkpointRecord (const char *filePath, time_t modified, uint64_t size);
+
+ /* Returns nonzero if the next checkpoint is due */
+ int checkpointDue (void);
+
+ /* Commits the records so far with the pending directories. Signals error with nonzero value */
+ int checkpointCommit (char * const *frontier, long count);
+
+ /* Closes the journal */
+ void checkpointClose (void);
+
+#endif
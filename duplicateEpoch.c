@@ -0,0 +1,219 @@
+/*
+********************************************************************************
+*
+* Filename     : duplicateEpoch.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Epoch-based reclamation of memory shared with reader threads.
+********************************************************************************
+*/
+
+#include "duplicateEpoch.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/*
+ * A reader entering a critical section publishes the global epoch in its slot
+ * (0 while outside one). Retiring a block tags it with the epoch, then
+ * advances the epoch. A reader that entered later read the epoch after the
+ * block was unlinked, so it can't reach the block: the block is freed once
+ * every occupied slot holds a later epoch. All slot and epoch accesses are
+ * sequentially consistent, which also covers a reader that enters while the
+ * writer is scanning the slots.
+ */
+
+/* Retired blocks that trigger a reclaim pass (at least) */
+#define EPOCH_BATCH     32
+
+/* A block waiting for the readers that may see it */
+typedef struct {
+    void *p;
+    size_t size;
+    EpochRelease release;
+    void *context;
+    uint64_t epoch;
+} Retired;
+
+/* A reader's slot (on its own cache line) */
+typedef struct {
+    _Alignas(64) atomic_uint_least64_t epoch;   // 0: outside a critical section.
+    atomic_int claimed;
+} Slot;
+
+/* Structure representing a domain */
+struct epochDomain {
+    _Alignas(64) atomic_uint_least64_t epoch;
+    atomic_int readers;
+    Slot slots[EPOCH_READERS];
+    pthread_mutex_t lock;       // Writers retiring at once (report workers).
+    atomic_int deferred;        // Nonzero while blocks are retired.
+    Retired *retired;
+    long retiredCount, retiredCapacity, reclaimAt;
+};
+
+/*
+ ******************************************************************************
+ *                             Private Functions
+ ******************************************************************************
+ */
+
+/* Returns the oldest epoch a reader is in, UINT64_MAX if none is */
+static uint64_t oldestReader (EpochDomain *d) {
+    uint64_t oldest = UINT64_MAX;
+
+    for (int i = 0; i < EPOCH_READERS; i++) {
+        uint64_t e = atomic_load(&d->slots[i].epoch);
+        if (e != 0 && e < oldest) {
+            oldest = e;
+        }
+    }
+    return oldest;
+}
+
+/* Frees the retired blocks no reader can see. Call with the lock held */
+static void reclaim (EpochDomain *d) {
+    uint64_t oldest = oldestReader(d);
+    long kept = 0;
+
+    for (long i = 0; i < d->retiredCount; i++) {
+        Retired *r = &d->retired[i];
+        if (r->epoch < oldest) {
+            r->release(r->context, r->p, r->size);
+        } else {
+            d->retired[kept++] = *r;
+        }
+    }
+    d->retiredCount = kept;
+    atomic_store_explicit(&d->deferred, kept != 0, memory_order_relaxed);
+
+    // Blocks pinned by a slow reader don't make every retire rescan them.
+    d->reclaimAt = 2 * kept > EPOCH_BATCH ? 2 * kept : EPOCH_BATCH;
+}
+
+/*
+ ******************************************************************************
+ *                             Public Functions
+ ******************************************************************************
+ */
+
+/* Creates a domain without readers */
+EpochDomain *epochCreate (void) {
+    EpochDomain *d;
+
+    if ((d = aligned_alloc(64, sizeof(EpochDomain))) == NULL) {
+        return NULL;
+    }
+    atomic_init(&d->epoch, 1);
+    atomic_init(&d->readers, 0);
+    for (int i = 0; i < EPOCH_READERS; i++) {
+        atomic_init(&d->slots[i].epoch, 0);
+        atomic_init(&d->slots[i].claimed, 0);
+    }
+    pthread_mutex_init(&d->lock, NULL);
+    atomic_init(&d->deferred, 0);
+    d->retired = NULL;
+    d->retiredCount = d->retiredCapacity = 0;
+    d->reclaimAt = EPOCH_BATCH;
+    return d;
+}
+
+/* Claims a reader slot. Returns it, or -1 if every slot is taken */
+int epochRegister (EpochDomain *d) {
+    for (int i = 0; i < EPOCH_READERS; i++) {
+        int free = 0;
+        if (atomic_compare_exchange_strong(&d->slots[i].claimed, &free, 1)) {
+            atomic_fetch_add(&d->readers, 1);
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Gives up a reader slot */
+void epochUnregister (EpochDomain *d, int slot) {
+    atomic_store(&d->slots[slot].epoch, 0);
+    atomic_fetch_sub(&d->readers, 1);
+    atomic_store(&d->slots[slot].claimed, 0);
+}
+
+/* Starts a read-side critical section */
+void epochEnter (EpochDomain *d, int slot) {
+    atomic_store(&d->slots[slot].epoch, atomic_load(&d->epoch));
+}
+
+/* Ends a read-side critical section */
+void epochExit (EpochDomain *d, int slot) {
+    atomic_store_explicit(&d->slots[slot].epoch, 0, memory_order_release);
+}
+
+/* Returns nonzero while any reader is registered */
+int epochShared (const EpochDomain *d) {
+    return atomic_load((atomic_int *)&d->readers) != 0;
+}
+
+/* Frees 'p' through 'release' once no reader can still see it */
+void epochRetire (EpochDomain *d, void *p, size_t size, EpochRelease release,
+                  void *context) {
+    uint64_t epoch;
+
+    // Order the unlink before the reader count, then skip deferring without readers.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&d->readers) == 0) {
+        release(context, p, size);
+
+        // Blocks the last readers kept are free now too.
+        if (atomic_load_explicit(&d->deferred, memory_order_relaxed)) {
+            pthread_mutex_lock(&d->lock);
+            reclaim(d);
+            pthread_mutex_unlock(&d->lock);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&d->lock);
+    epoch = atomic_fetch_add(&d->epoch, 1);
+    if (d->retiredCount == d->retiredCapacity) {
+        long capacity = d->retiredCapacity ? 2 * d->retiredCapacity : EPOCH_BATCH;
+        Retired *retired = realloc(d->retired, capacity * sizeof(Retired));
+
+        // Without room to defer it, wait for the readers to move on instead.
+        if (retired == NULL) {
+            while (oldestReader(d) <= epoch) {
+                sched_yield();
+            }
+            release(context, p, size);
+            pthread_mutex_unlock(&d->lock);
+            return;
+        }
+        d->retired = retired;
+        d->retiredCapacity = capacity;
+    }
+    d->retired[d->retiredCount++] = (Retired){p, size, release, context, epoch};
+    atomic_store_explicit(&d->deferred, 1, memory_order_relaxed);
+    if (d->retiredCount >= d->reclaimAt) {
+        reclaim(d);
+    }
+    pthread_mutex_unlock(&d->lock);
+}
+
+/* Frees everything retired, then the domain */
+void epochDestroy (EpochDomain *d) {
+    if (d == NULL) {
+        return;
+    }
+    for (long i = 0; i < d->retiredCount; i++) {
+        d->retired[i].release(d->retired[i].context, d->retired[i].p, d->retired[i].size);
+    }
+    free(d->retired);
+    pthread_mutex_destroy(&d->lock);
+    free(d);
+}
@@ -0,0 +1,67 @@
+/*
+********************************************************************************
+*
+* Filename     : duplicateEpoch.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Epoch-based reclamation of memory shared with reader threads.
+********************************************************************************
+*/
+
+#include <stddef.h>
+
+#if !defined(duplicateEpoch_h)
+#define duplicateEpoch_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Readers a domain admits at once */
+#define EPOCH_READERS   64
+
+/* Opaque reclamation domain */
+typedef struct epochDomain EpochDomain;
+
+/* Frees 'size' bytes at 'p' (a TrackerAllocator release function) */
+typedef void (*EpochRelease)(void *context, void *p, size_t size);
+
+/*
+ ******************************************************************************
+ *                                  Prototypes
+ ******************************************************************************
+ */
+
+ /* Creates a domain without readers. Returns NULL on failure */
+ EpochDomain *epochCreate (void);
+
+ /* Claims a reader slot. Returns it, or -1 if every slot is taken */
+ int epochRegister (EpochDomain *d);
+
+ /* Gives up reader slot 'slot' (outside a critical section) */
+ void epochUnregister (EpochDomain *d, int slot);
+
+ /* Starts a read-side critical section: memory retired after this point is
+  * kept until the matching epochExit. Never blocks */
+ void epochEnter (EpochDomain *d, int slot);
+
+ /* Ends a read-side critical section */
+ void epochExit (EpochDomain *d, int slot);
+
+ /* Returns nonzero while any reader is registered */
+ int epochShared (const EpochDomain *d);
+
+ /*
+  * Frees 'p' through 'release' once no reader can still see it. The caller has
+  * already unlinked it. Without registered readers it is freed at once. Any
+  * writer thread may retire (retiring takes a writers' lock, never a reader's).
+  */
+ void epochRetire (EpochDomain *d, void *p, size_t size, EpochRelease release,
+                   void *context);
+
+ /* Frees everything retired, then the domain (no reader may remain) */
+ void epochDestroy (EpochDomain *d);
+
+#endif
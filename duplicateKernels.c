@@ -0,0 +1,309 @@
+/*
+********************************************************************************
+*
+* Filename     : duplicateKernels.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Filter and sort kernels over group member arrays.
+********************************************************************************
+*/
+
+#include "duplicateKernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNEL_X86
+#endif
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/*
+ * The filter kernels test four members per step: mtimes against both bounds
+ * and sizes against the minimum (unsigned, so compared with the sign bit
+ * flipped), leaving a four bit pass mask. Counting adds the masked sizes;
+ * compaction turns the mask into indices through a table. Sorting is a stable
+ * LSD radix sort over the distance from the newest mtime, taking only as many
+ * digits as the range of mtimes spans (found with a vector min/max).
+ */
+
+/* Radix digit width and bucket count */
+#define RADIX_BITS      8
+#define RADIX_BUCKETS   (1 << RADIX_BITS)
+
+/* An implementation of the kernels */
+typedef struct {
+    const char *name;
+    uint32_t (*count)(const int64_t *, const uint64_t *, uint32_t, const KernelFilter *,
+                      uint64_t *);
+    uint32_t (*compact)(const int64_t *, const uint64_t *, uint32_t, uint32_t,
+                        const KernelFilter *, uint32_t *);
+    void (*range)(const int64_t *, uint32_t, int64_t *, int64_t *);
+} Kernels;
+
+/* The implementation in use, chosen once */
+static Kernels kernels;
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+
+/*
+ ******************************************************************************
+ *                             Scalar Kernels
+ ******************************************************************************
+ */
+
+/* Returns nonzero if a member passes 'filter' */
+static inline int passes (const KernelFilter *filter, int64_t modified, uint64_t size) {
+    return size >= filter->minSize && modified >= filter->from && modified <= filter->to;
+}
+
+/* Counts passing members and their bytes */
+static uint32_t countScalar (const int64_t *modified, const uint64_t *size, uint32_t count,
+                             const KernelFilter *filter, uint64_t *bytes) {
+    uint32_t passed = 0;
+    uint64_t total = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        int pass = passes(filter, modified[i], size[i]);
+        passed += pass;
+        total += pass ? size[i] : 0;
+    }
+    *bytes = total;
+    return passed;
+}
+
+/* Writes the indices of passing members in [start, end) */
+static uint32_t compactScalar (const int64_t *modified, const uint64_t *size, uint32_t start,
+                               uint32_t end, const KernelFilter *filter, uint32_t *selected) {
+    uint32_t n = 0;
+
+    for (uint32_t i = start; i < end; i++) {
+        selected[n] = i;
+        n += passes(filter, modified[i], size[i]);
+    }
+    return n;
+}
+
+/* Finds the smallest and largest key */
+static void rangeScalar (const int64_t *keys, uint32_t count, int64_t *low, int64_t *high) {
+    int64_t min = keys[0], max = keys[0];
+
+    for (uint32_t i = 1; i < count; i++) {
+        min = keys[i] < min ? keys[i] : min;
+        max = keys[i] > max ? keys[i] : max;
+    }
+    *low = min;
+    *high = max;
+}
+
+/*
+ ******************************************************************************
+ *                              AVX2 Kernels
+ ******************************************************************************
+ */
+
+#if defined(KERNEL_X86)
+
+/* Positions of the set bits of each four bit mask */
+static const uint32_t maskPositions[16][4] = {
+    {0, 0, 0, 0}, {0, 0, 0, 0}, {1, 0, 0, 0}, {0, 1, 0, 0},
+    {2, 0, 0, 0}, {0, 2, 0, 0}, {1, 2, 0, 0}, {0, 1, 2, 0},
+    {3, 0, 0, 0}, {0, 3, 0, 0}, {1, 3, 0, 0}, {0, 1, 3, 0},
+    {2, 3, 0, 0}, {0, 2, 3, 0}, {1, 2, 3, 0}, {0, 1, 2, 3}
+};
+
+/* Returns a lane mask of the members among four failing 'filter' */
+__attribute__((target("avx2")))
+static inline __m256i failsAvx2 (const int64_t *modified, const uint64_t *size, __m256i from,
+                                 __m256i to, __m256i minSize) {
+    const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+    __m256i m = _mm256_loadu_si256((const __m256i *)modified);
+    __m256i s = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)size), bias);
+
+    return _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi64(from, m),
+                                           _mm256_cmpgt_epi64(m, to)),
+                           _mm256_cmpgt_epi64(minSize, s));
+}
+
+/* Counts passing members and their bytes, four at a time */
+__attribute__((target("avx2,popcnt")))
+static uint32_t countAvx2 (const int64_t *modified, const uint64_t *size, uint32_t count,
+                           const KernelFilter *filter, uint64_t *bytes) {
+    __m256i from = _mm256_set1_epi64x(filter->from);
+    __m256i to = _mm256_set1_epi64x(filter->to);
+    __m256i minSize = _mm256_set1_epi64x((int64_t)(filter->minSize ^ (uint64_t)INT64_MIN));
+    __m256i total = _mm256_setzero_si256();
+    uint64_t lanes[4], tail;
+    uint32_t passed = 0, i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m256i fail = failsAvx2(modified + i, size + i, from, to, minSize);
+        __m256i s = _mm256_loadu_si256((const __m256i *)(size + i));
+        total = _mm256_add_epi64(total, _mm256_andnot_si256(fail, s));
+        passed += 4 - _mm_popcnt_u32(_mm256_movemask_pd(_mm256_castsi256_pd(fail)));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, total);
+
+    passed += countScalar(modified + i, size + i, count - i, filter, &tail);
+    *bytes = lanes[0] + lanes[1] + lanes[2] + lanes[3] + tail;
+    return passed;
+}
+
+/* Writes the indices of passing members in [start, end), four at a time */
+__attribute__((target("avx2,popcnt")))
+static uint32_t compactAvx2 (const int64_t *modified, const uint64_t *size, uint32_t start,
+                             uint32_t end, const KernelFilter *filter, uint32_t *selected) {
+    __m256i from = _mm256_set1_epi64x(filter->from);
+    __m256i to = _mm256_set1_epi64x(filter->to);
+    __m256i minSize = _mm256_set1_epi64x((int64_t)(filter->minSize ^ (uint64_t)INT64_MIN));
+    uint32_t n = 0, i = start;
+
+    // Each step stores four indices but keeps only the passing ones; since
+    // n <= i - start, the store stays below end - start.
+    for (; i + 4 <= end; i += 4) {
+        __m256i fail = failsAvx2(modified + i, size + i, from, to, minSize);
+        int mask = ~_mm256_movemask_pd(_mm256_castsi256_pd(fail)) & 0xf;
+        __m128i positions = _mm_loadu_si128((const __m128i *)maskPositions[mask]);
+        _mm_storeu_si128((__m128i *)(selected + n),
+                         _mm_add_epi32(positions, _mm_set1_epi32(i)));
+        n += _mm_popcnt_u32(mask);
+    }
+    return n + compactScalar(modified, size, i, end, filter, selected + n);
+}
+
+/* Finds the smallest and largest key, four lanes at a time */
+__attribute__((target("avx2")))
+static void rangeAvx2 (const int64_t *keys, uint32_t count, int64_t *low, int64_t *high) {
+    __m256i min = _mm256_set1_epi64x(keys[0]), max = min;
+    int64_t lanesLow[4], lanesHigh[4], tailLow, tailHigh;
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m256i k = _mm256_loadu_si256((const __m256i *)(keys + i));
+        min = _mm256_blendv_epi8(min, k, _mm256_cmpgt_epi64(min, k));
+        max = _mm256_blendv_epi8(max, k, _mm256_cmpgt_epi64(k, max));
+    }
+    _mm256_storeu_si256((__m256i *)lanesLow, min);
+    _mm256_storeu_si256((__m256i *)lanesHigh, max);
+
+    // The tail (or the first key again) folds in like a fifth lane.
+    rangeScalar(keys + (i < count ? i : 0), i < count ? count - i : 1, &tailLow, &tailHigh);
+    for (int lane = 0; lane < 4; lane++) {
+        tailLow = lanesLow[lane] < tailLow ? lanesLow[lane] : tailLow;
+        tailHigh = lanesHigh[lane] > tailHigh ? lanesHigh[lane] : tailHigh;
+    }
+    *low = tailLow;
+    *high = tailHigh;
+}
+
+#endif
+
+/*
+ ******************************************************************************
+ *                             Private Functions
+ ******************************************************************************
+ */
+
+/* Picks the implementation for this CPU (unless the environment says otherwise) */
+static void chooseKernels (void) {
+    const char *forced = getenv("DUPLICATE_KERNELS");
+
+    kernels = (Kernels){"scalar", countScalar, compactScalar, rangeScalar};
+#if defined(KERNEL_X86)
+    __builtin_cpu_init();
+    if ((forced == NULL || strcmp(forced, "scalar") != 0) &&
+        __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        kernels = (Kernels){"avx2", countAvx2, compactAvx2, rangeAvx2};
+    }
+#else
+    (void)forced;
+#endif
+}
+
+/* Returns the implementation in use */
+static inline const Kernels *activeKernels (void) {
+    pthread_once(&kernelsOnce, chooseKernels);
+    return &kernels;
+}
+
+/* Stable insertion sort of 'order' by descending key */
+static void insertionSort (const int64_t *keys, uint32_t count, uint32_t *order) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = i, j = i;
+        for (; j > 0 && keys[order[j - 1]] < keys[index]; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = index;
+    }
+}
+
+/*
+ ******************************************************************************
+ *                              Public Functions
+ ******************************************************************************
+ */
+
+/* Returns the active implementation ("avx2" or "scalar") */
+const char *kernelName (void) {
+    return activeKernels()->name;
+}
+
+/* Counts the members passing 'filter', summing their sizes into '*bytes' */
+uint32_t kernelCount (const int64_t *modified, const uint64_t *size, uint32_t count,
+                      const KernelFilter *filter, uint64_t *bytes) {
+    return activeKernels()->count(modified, size, count, filter, bytes);
+}
+
+/* Writes the indices of passing members among [start, end) to 'selected' */
+uint32_t kernelCompact (const int64_t *modified, const uint64_t *size, uint32_t start,
+                        uint32_t end, const KernelFilter *filter, uint32_t *selected) {
+    return activeKernels()->compact(modified, size, start, end, filter, selected);
+}
+
+/* Sets 'order' to the indices of 'keys' by descending key, ties in index order */
+void kernelSortDescending (const int64_t *keys, uint32_t count, uint32_t *order,
+                           uint32_t *scratch) {
+    uint32_t *from = order, *to = scratch;
+    int64_t low, high;
+    uint64_t range;
+
+    if (count <= KERNEL_SMALL) {
+        insertionSort(keys, count, order);
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+
+    // Sort ascending by distance from the newest key (only the digits it spans).
+    activeKernels()->range(keys, count, &low, &high);
+    range = (uint64_t)high - (uint64_t)low;
+    for (int shift = 0; shift < 64 && (range >> shift) != 0; shift += RADIX_BITS) {
+        uint32_t offsets[RADIX_BUCKETS] = {0};
+
+        for (uint32_t i = 0; i < count; i++) {
+            offsets[(((uint64_t)high - (uint64_t)keys[i]) >> shift) & (RADIX_BUCKETS - 1)]++;
+        }
+        for (uint32_t b = 0, sum = 0; b < RADIX_BUCKETS; b++) {
+            uint32_t n = offsets[b];
+            offsets[b] = sum;
+            sum += n;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t index = from[i];
+            to[offsets[(((uint64_t)high - (uint64_t)keys[index]) >> shift) &
+                       (RADIX_BUCKETS - 1)]++] = index;
+        }
+        uint32_t *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != order) {
+        memcpy(order, from, count * sizeof(uint32_t));
+    }
+}
@@ -0,0 +1,55 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateKernels.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Filter and sort kernels over group member arrays.
+********************************************************************************
+*/
+
+#include <stdint.h>
+
+#if !defined(duplicateKernels_h)
+#define duplicateKernels_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Member conditions in kernel form (inclusive bounds) */
+typedef struct {
+    int64_t from, to;
+    uint64_t minSize;
+} KernelFilter;
+
+/* Arrays at most this long are sorted by insertion */
+#define KERNEL_SMALL    48
+
+/*
+ ******************************************************************************
+ *                                  Prototypes
+ ******************************************************************************
+ */
+
+ /* Returns the active implementation ("avx2" or "scalar"). The environment
+  * variable DUPLICATE_KERNELS=scalar forces the portable one */
+ const char *kernelName (void);
+
+ /* Counts the members passing 'filter', summing their sizes into '*bytes' */
+ uint32_t kernelCount (const int64_t *modified, const uint64_t *size, uint32_t count,
+                       const KernelFilter *filter, uint64_t *bytes);
+
+ /* Writes the indices of passing members among [start, end) to 'selected',
+  * which has room for end - start. Returns how many were written */
+ uint32_t kernelCompact (const int64_t *modified, const uint64_t *size, uint32_t start,
+                         uint32_t end, const KernelFilter *filter, uint32_t *selected);
+
+ /* Sets 'order' to the indices of 'keys' by descending key, keeping ties in
+  * index order. 'scratch' holds 'count' indices */
+ void kernelSortDescending (const int64_t *keys, uint32_t count, uint32_t *order,
+                            uint32_t *scratch);
+
+#endif
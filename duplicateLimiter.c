@@ -0,0 +1,205 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateLimiter.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Shared rate limits, I/O priority and latency back-off.
+********************************************************************************
+*/
+
+#include "duplicateLimiter.h"
+#include "duplicateStatistics.h"
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* ioprio_set(2) constants (not exported by libc) */
+#define IOPRIO_WHO_PROCESS  1
+#define IOPRIO_CLASS_IDLE   3
+#define IOPRIO_CLASS_SHIFT  13
+
+/* Weight of a new sample in the stat latency average (1/n) */
+#define LATENCY_WEIGHT      16
+
+/*
+ * Each limit is a virtual schedule (GCRA): 'next' is the time the next unit is
+ * due. A caller reserves its units with one compare-and-swap and sleeps until
+ * its reservation, so threads share a limit without a lock and an idle limit
+ * costs a single relaxed load.
+ */
+typedef struct {
+    atomic_llong interval;      // Nanoseconds per unit, 0 when unlimited.
+    atomic_llong next;          // Time the next unit is due.
+} RateLimit;
+
+/* Nonzero once any limit or back-off is configured */
+atomic_int limiterActive;
+
+/* The limits */
+static RateLimit limits[LIMIT_COUNT];
+
+/* Back-off target and state: average latency and per-stat delay (ns) */
+static atomic_llong latencyTarget, latencyAverage, backoffDelay;
+
+/* Control file, and whether SIGHUP asked for it to be reread */
+static const char *controlPath;
+static volatile sig_atomic_t reloadRequested;
+
+/*
+ ******************************************************************************
+ *                             Auxillary Functions
+ ******************************************************************************
+ */
+
+/* Sleeps for 'nanos' nanoseconds */
+static void sleepNanos (long long nanos) {
+    struct timespec ts = {nanos / 1000000000LL, nanos % 1000000000LL};
+    while (nanosleep(&ts, &ts) == -1)
+        ;
+}
+
+/* SIGHUP handler: asks the scan loop to reread the control file */
+static void requestReload (int signal) {
+    (void)signal;
+    reloadRequested = 1;
+}
+
+/* Applies the settings in the control file. Signals error with nonzero value */
+static int readControlFile (void) {
+    static const char *keys[LIMIT_COUNT] = {"stats=", "dirs=", "bytes="};
+    char line[128];
+    FILE *control;
+
+    if ((control = fopen(controlPath, "r")) == NULL) {
+        return 1;
+    }
+    while (fgets(line, sizeof(line), control) != NULL) {
+        for (int k = 0; k < LIMIT_COUNT; k++) {
+            if (strncmp(line, keys[k], strlen(keys[k])) == 0) {
+                limiterSetRate(k, atof(line + strlen(keys[k])));
+            }
+        }
+        if (strncmp(line, "latency=", 8) == 0) {
+            limiterSetLatencyTarget(atof(line + 8));
+        }
+    }
+    fclose(control);
+    return 0;
+}
+
+/*
+ ******************************************************************************
+ *                             Public Functions
+ ******************************************************************************
+ */
+
+/* Sets the rate of 'kind' (units per second, 0 for unlimited) */
+void limiterSetRate (LimitKind kind, double perSecond) {
+    long long interval = perSecond > 0 ? (long long)(1e9 / perSecond) : 0;
+
+    atomic_store(&limits[kind].interval, interval > 0 || perSecond <= 0 ? interval : 1);
+    if (perSecond > 0) {
+        atomic_store_explicit(&limiterActive, 1, memory_order_relaxed);
+    }
+}
+
+/* Enables back-off once the average stat latency exceeds 'millis' */
+void limiterSetLatencyTarget (double millis) {
+    atomic_store(&latencyTarget, (long long)(millis * 1e6));
+    if (millis > 0) {
+        atomic_store_explicit(&limiterActive, 1, memory_order_relaxed);
+    }
+}
+
+/* Reads the control file now and on every SIGHUP */
+int limiterWatch (const char *path) {
+    struct sigaction action;
+
+    controlPath = path;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestReload;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGHUP, &action, NULL) == -1) {
+        return 1;
+    }
+
+    // Limits may be raised from zero later, so keep the checks in place.
+    atomic_store_explicit(&limiterActive, 1, memory_order_relaxed);
+    return readControlFile();
+}
+
+/* Puts the process in the idle I/O class */
+int limiterIdlePriority (void) {
+    return syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                   IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) == -1;
+}
+
+/* Waits until 'units' of 'kind' may be used */
+void limiterAcquire (LimitKind kind, long units) {
+    RateLimit *l = &limits[kind];
+    long long interval = atomic_load_explicit(&l->interval, memory_order_relaxed);
+    long long now, next, start;
+
+    if (interval == 0) {
+        return;
+    }
+
+    // Reserve the units: an idle limit restarts its schedule now.
+    now = statsNanos();
+    next = atomic_load_explicit(&l->next, memory_order_relaxed);
+    do {
+        start = next > now ? next : now;
+    } while (!atomic_compare_exchange_weak(&l->next, &next, start + interval * units));
+
+    if (start - now > LIMIT_TOLERANCE) {
+        sleepNanos(start - now - LIMIT_TOLERANCE);
+    }
+}
+
+/* Reports a stat latency, sleeping if back-off is in effect */
+void limiterStatLatency (long long nanos) {
+    long long target = atomic_load_explicit(&latencyTarget, memory_order_relaxed);
+    long long average, delay;
+
+    if (target == 0) {
+        return;
+    }
+
+    // Exponentially weighted average of the latency.
+    average = atomic_load_explicit(&latencyAverage, memory_order_relaxed);
+    average += (nanos - average) / LATENCY_WEIGHT;
+    atomic_store_explicit(&latencyAverage, average, memory_order_relaxed);
+
+    // Back off multiplicatively while over target, recover the same way.
+    delay = atomic_load_explicit(&backoffDelay, memory_order_relaxed);
+    if (average > target) {
+        delay = delay * 2 + 10000 < BACKOFF_MAX ? delay * 2 + 10000 : BACKOFF_MAX;
+    } else {
+        delay /= 2;
+    }
+    atomic_store_explicit(&backoffDelay, delay, memory_order_relaxed);
+
+    if (delay > 0) {
+        sleepNanos(delay);
+    }
+}
+
+/* Applies a pending control file reload */
+void limiterPoll (void) {
+    if (reloadRequested) {
+        reloadRequested = 0;
+        if (readControlFile()) {
+            fprintf(stderr, "Error: Can't read control file %s!\n", controlPath);
+        }
+    }
+}
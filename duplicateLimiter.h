@@ -0,0 +1,67 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateLimiter.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Shared rate limits, I/O priority and latency back-off.
+********************************************************************************
+*/
+
+#include <stdatomic.h>
+
+#if !defined(duplicateLimiter_h)
+#define duplicateLimiter_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Limited resources */
+typedef enum {
+    LIMIT_STATS,        // stat() calls per second.
+    LIMIT_DIRS,         // Directories opened per second.
+    LIMIT_BYTES,        // Directory stream bytes read per second.
+    LIMIT_COUNT
+} LimitKind;
+
+/* Delay that may be borrowed ahead of the schedule (nanoseconds) */
+#define LIMIT_TOLERANCE     50000000LL
+
+/* Longest back-off delay per stat (nanoseconds) */
+#define BACKOFF_MAX         100000000LL
+
+/* Nonzero once any limit or back-off is configured (read relaxed) */
+extern atomic_int limiterActive;
+
+/*
+ ******************************************************************************
+ *                                  Prototypes
+ ******************************************************************************
+ */
+
+ /* Sets the rate of 'kind' (units per second, 0 for unlimited) */
+ void limiterSetRate (LimitKind kind, double perSecond);
+
+ /* Enables back-off once the average stat latency exceeds 'millis' */
+ void limiterSetLatencyTarget (double millis);
+
+ /* Reads "stats=", "dirs=", "bytes=" and "latency=" lines from 'path' now and
+  * on every SIGHUP. Signals error with nonzero value */
+ int limiterWatch (const char *path);
+
+ /* Puts the process in the idle I/O class. Signals error with nonzero value */
+ int limiterIdlePriority (void);
+
+ /* Waits until 'units' of 'kind' may be used. Safe from any thread */
+ void limiterAcquire (LimitKind kind, long units);
+
+ /* Reports a stat latency, sleeping if back-off is in effect */
+ void limiterStatLatency (long long nanos);
+
+ /* Applies a pending control file reload (call from the scan loop) */
+ void limiterPoll (void);
+
+#endif
@@ -0,0 +1,158 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateMemory.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Accounting allocators for the tracker's data structures.
+********************************************************************************
+*/
+
+#include "duplicateMemory.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <malloc.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Category names, in MemCategory order */
+static const char *categoryNames[MEM_CATEGORIES] = {
+    "table", "nodes", "paths", "groups", "caches"
+};
+
+/* Live account of a category, updated without ordering guarantees */
+typedef struct {
+    atomic_long allocations;
+    atomic_size_t requested, usable, used;
+} Account;
+
+/* Live accounts */
+static Account accounts[MEM_CATEGORIES];
+
+/*
+ ******************************************************************************
+ *                             Auxillary Functions
+ ******************************************************************************
+ */
+
+/* Charges (sign 1) or refunds (sign -1) an allocation */
+static void charge (MemCategory category, int sign, size_t requested,
+                    size_t usable, size_t used) {
+    Account *a = &accounts[category];
+
+    if (sign > 0) {
+        atomic_fetch_add_explicit(&a->allocations, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&a->requested, requested, memory_order_relaxed);
+        atomic_fetch_add_explicit(&a->usable, usable, memory_order_relaxed);
+        atomic_fetch_add_explicit(&a->used, used, memory_order_relaxed);
+    } else {
+        atomic_fetch_sub_explicit(&a->allocations, 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&a->requested, requested, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&a->usable, usable, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&a->used, used, memory_order_relaxed);
+    }
+}
+
+/* Returns 'part' as a percentage of 'whole' */
+static double percent (size_t part, size_t whole) {
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+/*
+ ******************************************************************************
+ *                             Public Functions
+ ******************************************************************************
+ */
+
+/* Allocates 'size' bytes of which 'used' hold payload, charged to 'category' */
+void *memAlloc (MemCategory category, size_t size, size_t used) {
+    void *p;
+
+    if ((p = malloc(size)) != NULL) {
+        charge(category, 1, size, malloc_usable_size(p), used);
+    }
+    return p;
+}
+
+/* Resizes 'p' to 'size' bytes of which 'used' hold payload */
+void *memRealloc (MemCategory category, void *p, size_t oldSize, size_t oldUsed,
+                  size_t size, size_t used) {
+    size_t oldUsable = p != NULL ? malloc_usable_size(p) : 0;
+    void *q;
+
+    if ((q = realloc(p, size)) == NULL) {
+        return NULL;
+    }
+    if (p != NULL) {
+        charge(category, -1, oldSize, oldUsable, oldUsed);
+    }
+    charge(category, 1, size, malloc_usable_size(q), used);
+    return q;
+}
+
+/* Frees 'p', which was allocated as 'size' bytes holding 'used' payload */
+void memFree (MemCategory category, void *p, size_t size, size_t used) {
+    if (p == NULL) {
+        return;
+    }
+    charge(category, -1, size, malloc_usable_size(p), used);
+    free(p);
+}
+
+/* Copies the live accounts of every category into 'out' */
+void getMemoryAccounts (MemAccount out[MEM_CATEGORIES]) {
+    for (int c = 0; c < MEM_CATEGORIES; c++) {
+        out[c].allocations = atomic_load_explicit(&accounts[c].allocations, memory_order_relaxed);
+        out[c].requested = atomic_load_explicit(&accounts[c].requested, memory_order_relaxed);
+        out[c].usable = atomic_load_explicit(&accounts[c].usable, memory_order_relaxed);
+        out[c].used = atomic_load_explicit(&accounts[c].used, memory_order_relaxed);
+    }
+}
+
+/* Prints live bytes, bytes per file and waste for every category */
+void printMemoryReport (FILE *out, long files) {
+    MemAccount a[MEM_CATEGORIES];
+    size_t usable = 0, used = 0;
+
+    getMemoryAccounts(a);
+    fprintf(out, "Memory (%ld files):\n", files);
+    fprintf(out, "\t%-8s%12s%14s%12s%10s%10s\n", "", "allocs", "bytes", "bytes/file",
+            "slack", "unused");
+    for (int c = 0; c < MEM_CATEGORIES; c++) {
+        fprintf(out, "\t%-8s%12ld%14zu%12.1f%9.1f%%%9.1f%%\n", categoryNames[c],
+                a[c].allocations, a[c].usable,
+                files ? (double)a[c].usable / files : 0.0,
+                percent(a[c].usable - a[c].requested, a[c].usable),
+                percent(a[c].requested - a[c].used, a[c].usable));
+        usable += a[c].usable;
+        used += a[c].used;
+    }
+    fprintf(out, "\t%-8s%12s%14zu%12.1f%9s%10.1f%%\n", "total", "", usable,
+            files ? (double)usable / files : 0.0, "", percent(usable - used, usable));
+}
+
+/* Prints the memory a scan of 'projectedFiles' files is expected to need */
+void printMemoryEstimate (FILE *out, long sampleFiles, long projectedFiles) {
+    MemAccount a[MEM_CATEGORIES];
+    double perFile = 0.0;
+
+    if (sampleFiles == 0) {
+        fprintf(out, "Estimate: The sample holds no files!\n");
+        return;
+    }
+
+    // The table grows with the groups, so every structure scales with the files.
+    getMemoryAccounts(a);
+    for (int c = 0; c < MEM_CATEGORIES; c++) {
+        perFile += (double)a[c].usable / sampleFiles;
+    }
+
+    fprintf(out, "Estimate: %.1f bytes/file over %ld sampled files\n", perFile,
+            sampleFiles);
+    fprintf(out, "Estimate: %ld files need about %.1f MiB\n", projectedFiles,
+            perFile * projectedFiles / (1024.0 * 1024.0));
+}
@@ -0,0 +1,66 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateMemory.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Accounting allocators for the tracker's data structures.
+********************************************************************************
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+
+#if !defined(duplicateMemory_h)
+#define duplicateMemory_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Accounted data structures */
+typedef enum {
+    MEM_TABLE,
+    MEM_NODES,
+    MEM_PATHS,
+    MEM_GROUPS,
+    MEM_CACHES,
+    MEM_CATEGORIES
+} MemCategory;
+
+/* Live allocations of one category */
+typedef struct {
+    long allocations;
+    size_t requested;   // Bytes asked of the allocator.
+    size_t usable;      // Bytes the allocator actually handed out.
+    size_t used;        // Bytes holding payload (e.g. a path's length).
+} MemAccount;
+
+/*
+ ******************************************************************************
+ *                                  Prototypes
+ ******************************************************************************
+ */
+
+ /* Allocates 'size' bytes of which 'used' hold payload, charged to 'category' */
+ void *memAlloc (MemCategory category, size_t size, size_t used);
+
+ /* Resizes 'p' to 'size' bytes of which 'used' hold payload */
+ void *memRealloc (MemCategory category, void *p, size_t oldSize, size_t oldUsed,
+                   size_t size, size_t used);
+
+ /* Frees 'p', which was allocated as 'size' bytes holding 'used' payload */
+ void memFree (MemCategory category, void *p, size_t size, size_t used);
+
+ /* Copies the live accounts of every category into 'accounts' */
+ void getMemoryAccounts (MemAccount accounts[MEM_CATEGORIES]);
+
+ /* Prints live bytes, bytes per file and waste for every category */
+ void printMemoryReport (FILE *out, long files);
+
+ /* Prints the memory a scan of 'projectedFiles' files is expected to need */
+ void printMemoryEstimate (FILE *out, long sampleFiles, long projectedFiles);
+
+#endif
@@ -0,0 +1,347 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicatePaths.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Front-coded, block-compressed store of file paths.
+********************************************************************************
+*/
+
+#include "duplicatePaths.h"
+#include "duplicateMemory.h"
+#if defined(PATH_ZLIB)
+#include <pthread.h>
+#include <zlib.h>
+#endif
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/*
+ * Paths arrive in scan order, so neighbours mostly share their directory. Each
+ * block of PATH_BLOCK paths stores its first path whole and every other one as
+ * the length of the prefix it shares with its predecessor, the length of the
+ * rest, and the rest (lengths are varints). Built with -DPATH_ZLIB (and -lz),
+ * full blocks are also deflated when that makes them smaller. Decoding happens
+ * only when a path is read.
+ *
+ * Readers in other threads find sealed blocks through the published block
+ * count and decode the open block from the bytes already written. While there
+ * are readers, replaced buffers are retired rather than freed, and a sealed
+ * block's buffer isn't reused for the next block.
+ */
+
+/* Header of a sealed block */
+typedef struct {
+    uint32_t rawLength;         // Front-coded length.
+    uint32_t storedLength;      // Bytes following, less than raw if deflated.
+} BlockHeader;
+
+/* The store */
+struct pathStore {
+    TrackerAllocator allocator;
+    EpochDomain *epochs;
+    BlockHeader **blocks;       // Sealed blocks.
+    long blockCount;
+    size_t blockCapacity;       // Bytes.
+    unsigned char *open;        // The block being filled (front-coded).
+    size_t openLength, openCapacity;
+    char last[MAX_PATH];        // The block's previous path.
+    size_t lastLength;
+    PathId count;
+    uint64_t rawBytes, storedBytes;
+};
+
+/* Scratch space for inflating blocks, per thread (freed when the thread exits) */
+#if defined(PATH_ZLIB)
+typedef struct {
+    unsigned char *data;
+    size_t capacity;
+} InflateBuffer;
+
+static pthread_key_t inflateKey;
+static pthread_once_t inflateOnce = PTHREAD_ONCE_INIT;
+static int inflateKeyFailed;
+#endif
+
+/*
+ ******************************************************************************
+ *                             Auxillary Functions
+ ******************************************************************************
+ */
+
+/* Writes 'value' as a varint at 'p'. Returns the bytes written */
+static size_t putVarint (unsigned char *p, size_t value) {
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        p[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    p[n++] = (unsigned char)value;
+    return n;
+}
+
+/* Reads a varint at '*p', advancing it */
+static size_t getVarint (const unsigned char **p) {
+    size_t value = 0;
+    int shift = 0;
+
+    while (**p & 0x80) {
+        value |= (size_t)(*(*p)++ & 0x7f) << shift;
+        shift += 7;
+    }
+    return value | (size_t)*(*p)++ << shift;
+}
+
+#if defined(PATH_ZLIB)
+/* Frees a thread's inflate buffer */
+static void freeInflateBuffer (void *p) {
+    InflateBuffer *b = p;
+
+    memFree(MEM_CACHES, b->data, b->capacity, b->capacity);
+    memFree(MEM_CACHES, b, sizeof(InflateBuffer), sizeof(InflateBuffer));
+}
+
+/* Creates the key owning the threads' inflate buffers */
+static void createInflateKey (void) {
+    inflateKeyFailed = pthread_key_create(&inflateKey, freeInflateBuffer) != 0;
+}
+
+/* Returns the thread's inflate buffer grown to 'needed' bytes, or NULL on failure */
+static unsigned char *inflateBuffer (size_t needed) {
+    InflateBuffer *b;
+    unsigned char *grown;
+
+    pthread_once(&inflateOnce, createInflateKey);
+    if (inflateKeyFailed) {
+        return NULL;
+    }
+    if ((b = pthread_getspecific(inflateKey)) == NULL) {
+        if ((b = memAlloc(MEM_CACHES, sizeof(InflateBuffer), sizeof(InflateBuffer))) == NULL) {
+            return NULL;
+        }
+        *b = (InflateBuffer){NULL, 0};
+        if (pthread_setspecific(inflateKey, b) != 0) {
+            freeInflateBuffer(b);
+            return NULL;
+        }
+    }
+
+    // The old buffer stays usable if it can't grow.
+    if (b->capacity < needed) {
+        if ((grown = memRealloc(MEM_CACHES, b->data, b->capacity, b->capacity, needed,
+                                needed)) == NULL) {
+            return NULL;
+        }
+        b->data = grown;
+        b->capacity = needed;
+    }
+    return b->data;
+}
+#endif
+
+/* Frees a buffer readers may still be decoding from */
+static void releaseBuffer (PathStore *s, void *p, size_t capacity) {
+    if (p == NULL) {
+        return;
+    }
+    if (s->epochs != NULL) {
+        epochRetire(s->epochs, p, capacity, s->allocator.release, s->allocator.context);
+    } else {
+        s->allocator.release(s->allocator.context, p, capacity);
+    }
+}
+
+/* Grows buffer '*p' of '*capacity' bytes holding 'length' to hold 'needed' */
+static int growBuffer (PathStore *s, void **p, size_t *capacity, size_t length,
+                       size_t needed) {
+    size_t grown = *capacity ? *capacity : 256;
+    void *q;
+
+    if (needed <= *capacity) {
+        return 0;
+    }
+    while (grown < needed) {
+        grown *= 2;
+    }
+    if ((q = s->allocator.allocate(s->allocator.context, grown)) == NULL) {
+        return 1;
+    }
+    if (*p != NULL) {
+        memcpy(q, *p, length);
+    }
+    releaseBuffer(s, __atomic_exchange_n(p, q, __ATOMIC_ACQ_REL), *capacity);
+    *capacity = grown;
+    return 0;
+}
+
+/* Moves the open block into its own exactly sized (or deflated) allocation */
+static int sealBlock (PathStore *s) {
+    const unsigned char *data = s->open;
+    size_t stored = s->openLength;
+    BlockHeader *block;
+
+    if (growBuffer(s, (void **)&s->blocks, &s->blockCapacity,
+                   s->blockCount * sizeof(BlockHeader *),
+                   (s->blockCount + 1) * sizeof(BlockHeader *))) {
+        return 1;
+    }
+
+#if defined(PATH_ZLIB)
+    unsigned char packed[PATH_BLOCK * 128];
+    uLongf packedLength = sizeof(packed);
+    if (s->openLength > sizeof(BlockHeader) &&
+        compress2(packed, &packedLength, s->open, s->openLength, Z_BEST_SPEED) == Z_OK &&
+        packedLength < s->openLength) {
+        data = packed;
+        stored = packedLength;
+    }
+#endif
+
+    if ((block = s->allocator.allocate(s->allocator.context,
+                                       sizeof(BlockHeader) + stored)) == NULL) {
+        return 1;
+    }
+    block->rawLength = s->openLength;
+    block->storedLength = stored;
+    memcpy(block + 1, data, stored);
+    s->blocks[s->blockCount] = block;
+    __atomic_store_n(&s->blockCount, s->blockCount + 1, __ATOMIC_RELEASE);
+    s->storedBytes += sizeof(BlockHeader) + stored + sizeof(BlockHeader *);
+    s->openLength = 0;
+    s->lastLength = 0;
+
+    // A reader may still be decoding the old open block, so start a new buffer.
+    if (s->epochs != NULL && epochShared(s->epochs)) {
+        releaseBuffer(s, __atomic_exchange_n(&s->open, NULL, __ATOMIC_ACQ_REL),
+                      s->openCapacity);
+        s->openCapacity = 0;
+    }
+    return 0;
+}
+
+/*
+ ******************************************************************************
+ *                             Public Functions
+ ******************************************************************************
+ */
+
+/* Creates an empty store */
+PathStore *pathStoreCreate (const TrackerAllocator *allocator, EpochDomain *epochs) {
+    PathStore *s;
+
+    if ((s = allocator->allocate(allocator->context, sizeof(PathStore))) == NULL) {
+        return NULL;
+    }
+    memset(s, 0, sizeof(PathStore));
+    s->allocator = *allocator;
+    s->epochs = epochs;
+    return s;
+}
+
+/* Appends a path, setting '*id' */
+int pathStoreAdd (PathStore *s, const char *path, size_t length, PathId *id) {
+    size_t shared = 0, openLength = s->openLength;
+    int fills = (s->count + 1) % PATH_BLOCK == 0;
+
+    if (length >= MAX_PATH) {
+        return 1;
+    }
+
+    // Share the longest prefix with the block's previous path.
+    while (shared < s->lastLength && shared < length && s->last[shared] == path[shared]) {
+        shared++;
+    }
+    if (growBuffer(s, (void **)&s->open, &s->openCapacity, s->openLength,
+                   s->openLength + 2 * sizeof(size_t) + length - shared)) {
+        return 1;
+    }
+    s->openLength += putVarint(s->open + s->openLength, shared);
+    s->openLength += putVarint(s->open + s->openLength, length - shared);
+    memcpy(s->open + s->openLength, path + shared, length - shared);
+    s->openLength += length - shared;
+
+    // A full block is sealed before the id is given out, else the path is dropped.
+    if (fills) {
+        if (sealBlock(s)) {
+            s->openLength = openLength;
+            return 1;
+        }
+    } else {
+        memcpy(s->last + shared, path + shared, length - shared);
+        s->lastLength = length;
+    }
+    s->rawBytes += length + 1;
+    *id = s->count++;
+    return 0;
+}
+
+/* Decodes path 'id' into 'buffer', setting '*length'. Signals error with nonzero value */
+int pathStoreGet (const PathStore *s, PathId id, char buffer[MAX_PATH], size_t *length) {
+    long block = id / PATH_BLOCK;
+    const unsigned char *p, *open;
+    size_t decoded = 0;
+
+    // The open buffer first: once it is replaced, the block count covers the old one.
+    open = __atomic_load_n(&s->open, __ATOMIC_ACQUIRE);
+    if (block < __atomic_load_n(&s->blockCount, __ATOMIC_ACQUIRE)) {
+        const BlockHeader *header = __atomic_load_n(&s->blocks, __ATOMIC_ACQUIRE)[block];
+        p = (const unsigned char *)(header + 1);
+#if defined(PATH_ZLIB)
+        if (header->storedLength < header->rawLength) {
+            uLongf rawLength = header->rawLength;
+            unsigned char *inflated = inflateBuffer(rawLength);
+            if (inflated == NULL ||
+                uncompress(inflated, &rawLength, p, header->storedLength) != Z_OK ||
+                rawLength != header->rawLength) {
+                return 1;
+            }
+            p = inflated;
+        }
+#endif
+    } else {
+        p = open;
+    }
+
+    // Replay the block's prefixes up to the path.
+    for (PathId i = 0; i <= id % PATH_BLOCK; i++) {
+        size_t shared = getVarint(&p), rest = getVarint(&p);
+        memcpy(buffer + shared, p, rest);
+        p += rest;
+        decoded = shared + rest;
+    }
+    buffer[decoded] = '\0';
+    if (length != NULL) {
+        *length = decoded;
+    }
+    return 0;
+}
+
+/* Returns the bytes of the paths added, and the bytes storing them */
+void pathStoreUsage (const PathStore *s, uint64_t *rawBytes, uint64_t *storedBytes) {
+    *rawBytes = s->rawBytes;
+    *storedBytes = s->storedBytes + s->openLength;
+}
+
+/* Frees the store */
+void pathStoreDestroy (PathStore *s) {
+    if (s == NULL) {
+        return;
+    }
+    for (long i = 0; i < s->blockCount; i++) {
+        s->allocator.release(s->allocator.context, s->blocks[i],
+                             sizeof(BlockHeader) + s->blocks[i]->storedLength);
+    }
+    if (s->blocks != NULL) {
+        s->allocator.release(s->allocator.context, s->blocks, s->blockCapacity);
+    }
+    if (s->open != NULL) {
+        s->allocator.release(s->allocator.context, s->open, s->openCapacity);
+    }
+    s->allocator.release(s->allocator.context, s, sizeof(PathStore));
+}
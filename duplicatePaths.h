@@ -0,0 +1,62 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicatePaths.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Front-coded, block-compressed store of file paths.
+********************************************************************************
+*/
+
+#include "duplicateTracker.h"
+#include "duplicateEpoch.h"
+
+#if !defined(duplicatePaths_h)
+#define duplicatePaths_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Paths per block. Decoding a path walks its block from the start */
+#if !defined(PATH_BLOCK)
+#define PATH_BLOCK      32
+#endif
+
+/* Paths are numbered in the order they are added */
+typedef uint32_t PathId;
+
+/* Opaque path store */
+typedef struct pathStore PathStore;
+
+/*
+ ******************************************************************************
+ *                                  Prototypes
+ ******************************************************************************
+ */
+
+ /*
+  * Creates an empty store allocating through 'allocator'. Buffers it replaces
+  * are retired to 'epochs' (may be NULL), so threads in its critical sections
+  * can decode paths while one thread adds them. Returns NULL on failure.
+  */
+ PathStore *pathStoreCreate (const TrackerAllocator *allocator, EpochDomain *epochs);
+
+ /* Appends a path, setting '*id'. Signals error with nonzero value */
+ int pathStoreAdd (PathStore *s, const char *path, size_t length, PathId *id);
+
+ /* Decodes path 'id' into 'buffer', setting '*length' (may be NULL). Another
+  * thread may decode any id already returned by pathStoreAdd (see
+  * pathStoreCreate). Signals error (a block that can't be inflated) with
+  * nonzero value */
+ int pathStoreGet (const PathStore *s, PathId id, char buffer[MAX_PATH], size_t *length);
+
+ /* Returns the bytes of the paths added, and the bytes storing them */
+ void pathStoreUsage (const PathStore *s, uint64_t *rawBytes, uint64_t *storedBytes);
+
+ /* Frees the store */
+ void pathStoreDestroy (PathStore *s);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateProbes.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : USDT static tracepoints (no-ops without <sys/sdt.h>).
+********************************************************************************
+*/
+
+#if !defined(duplicateProbes_h)
+#define duplicateProbes_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Probes are compiled in when systemtap's header is present (-DNO_PROBES to opt out) */
+#if !defined(NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PROBES_ENABLED  1
+#endif
+#endif
+
+/*
+ * Provider "duplicateScanner". Phases fire a start/done pair so tracers can
+ * take latencies from their own clock; a probe site is a single nop until a
+ * tracer attaches, so the scan never pays for timestamps it doesn't use.
+ */
+#if defined(PROBES_ENABLED)
+
+/* Directory opened: path, path length */
+#define PROBE_DIR_OPEN(path, length)                                          \
+    DTRACE_PROBE2(duplicateScanner, dir__open, path, length)
+
+/* Directory closed: path, entries read */
+#define PROBE_DIR_CLOSE(path, entries)                                        \
+    DTRACE_PROBE2(duplicateScanner, dir__close, path, entries)
+
+/* stat() issued: path */
+#define PROBE_STAT_START(path)                                                \
+    DTRACE_PROBE1(duplicateScanner, stat__start, path)
+
+/* stat() returned: path, path length, status */
+#define PROBE_STAT_DONE(path, length, status)                                 \
+    DTRACE_PROBE3(duplicateScanner, stat__done, path, length, status)
+
+/* trackFile entered: path, path length */
+#define PROBE_TRACK_START(path, length)                                       \
+    DTRACE_PROBE2(duplicateScanner, track__start, path, length)
+
+/* trackFile returned: status, files tracked so far */
+#define PROBE_TRACK_DONE(status, files)                                       \
+    DTRACE_PROBE2(duplicateScanner, track__done, status, files)
+
+/* Table (re)allocated: old bucket count, new bucket count */
+#define PROBE_TABLE_RESIZE(oldBuckets, newBuckets)                            \
+    DTRACE_PROBE2(duplicateScanner, table__resize, oldBuckets, newBuckets)
+
+/* Report started */
+#define PROBE_REPORT_START()                                                  \
+    DTRACE_PROBE(duplicateScanner, report__start)
+
+/* Report emitted: groups printed, bytes written */
+#define PROBE_REPORT_DONE(groups, bytes)                                      \
+    DTRACE_PROBE2(duplicateScanner, report__done, groups, bytes)
+
+#else
+
+/* Without probes the arguments are still evaluated, for their side effects */
+#define PROBE_DIR_OPEN(path, length)                ((void)(path), (void)(length))
+#define PROBE_DIR_CLOSE(path, entries)              ((void)(path), (void)(entries))
+#define PROBE_STAT_START(path)                      ((void)(path))
+#define PROBE_STAT_DONE(path, length, status)       ((void)(path), (void)(length), (void)(status))
+#define PROBE_TRACK_START(path, length)             ((void)(path), (void)(length))
+#define PROBE_TRACK_DONE(status, files)             ((void)(status), (void)(files))
+#define PROBE_TABLE_RESIZE(oldBuckets, newBuckets)  ((void)(oldBuckets), (void)(newBuckets))
+#define PROBE_REPORT_START()                        ((void)0)
+#define PROBE_REPORT_DONE(groups, bytes)            ((void)(groups), (void)(bytes))
+
+#endif
+
+#endif
@@ -0,0 +1,92 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateProgress.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Live scan progress sampled from relaxed atomic counters.
+********************************************************************************
+*/
+
+#include "duplicateProgress.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Files tracked, directories scanned and directories waiting to be scanned */
+atomic_long progressFiles, progressDirs, progressPending;
+
+/* The reporter thread */
+static pthread_t reporter;
+
+/* Nonzero while the reporter should keep running */
+static atomic_int reporting;
+
+/*
+ ******************************************************************************
+ *                             Auxillary Functions
+ ******************************************************************************
+ */
+
+/* Returns the current monotonic time in seconds */
+static double monotonicTime (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Prints one progress line over the previous one */
+static void printSample (double elapsed) {
+    long files = atomic_load_explicit(&progressFiles, memory_order_relaxed);
+    long dirs = atomic_load_explicit(&progressDirs, memory_order_relaxed);
+    long pending = atomic_load_explicit(&progressPending, memory_order_relaxed);
+    double dirRate = elapsed > 0 ? dirs / elapsed : 0.0;
+
+    // The queue only holds known directories, so the ETA is a lower bound.
+    fprintf(stderr, "\r%ld files (%.0f/s), %ld dirs (%.0f/s), %ld queued, ETA >= %.0fs   ",
+            files, elapsed > 0 ? files / elapsed : 0.0, dirs, dirRate, pending,
+            dirRate > 0 ? pending / dirRate : 0.0);
+}
+
+/* Reporter thread: samples the counters every PROGRESS_INTERVAL */
+static void *reportProgress (void *arg) {
+    struct timespec interval = {0, PROGRESS_INTERVAL * 1000000L};
+    double start = monotonicTime();
+
+    (void)arg;
+    while (atomic_load(&reporting)) {
+        nanosleep(&interval, NULL);
+        printSample(monotonicTime() - start);
+    }
+    fputc('\n', stderr);
+    return NULL;
+}
+
+/*
+ ******************************************************************************
+ *                             Public Functions
+ ******************************************************************************
+ */
+
+/* Starts the reporter thread. Signals error with nonzero value */
+int startProgress (void) {
+    atomic_store(&reporting, 1);
+    if (pthread_create(&reporter, NULL, reportProgress, NULL) != 0) {
+        atomic_store(&reporting, 0);
+        return 1;
+    }
+    return 0;
+}
+
+/* Stops the reporter thread after printing a final sample */
+void stopProgress (void) {
+    if (atomic_exchange(&reporting, 0)) {
+        pthread_join(reporter, NULL);
+    }
+}
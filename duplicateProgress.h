@@ -0,0 +1,44 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateProgress.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Live scan progress sampled from relaxed atomic counters.
+********************************************************************************
+*/
+
+#include <stdatomic.h>
+
+#if !defined(duplicateProgress_h)
+#define duplicateProgress_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Reporter refresh interval (milliseconds) */
+#define PROGRESS_INTERVAL   250
+
+/* Files tracked, directories scanned and directories waiting to be scanned */
+extern atomic_long progressFiles, progressDirs, progressPending;
+
+/* Adds 'n' to a progress counter without ordering guarantees */
+#define PROGRESS_ADD(counter, n)                                              \
+    atomic_fetch_add_explicit(&(counter), (n), memory_order_relaxed)
+
+/*
+ ******************************************************************************
+ *                                  Prototypes
+ ******************************************************************************
+ */
+
+ /* Starts the reporter thread. Signals error with nonzero value */
+ int startProgress (void);
+
+ /* Stops the reporter thread after printing a final sample */
+ void stopProgress (void);
+
+#endif
@@ -0,0 +1,207 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateRing.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Bounded lock-free rings passing pointers between threads.
+********************************************************************************
+*/
+
+#include "duplicateRing.h"
+#include "duplicateStatistics.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/*
+ * Each cell carries a sequence number (Vyukov's bounded queue). A cell is free
+ * for the push at position p when its sequence is p, and holds the item for
+ * the pop at p once its sequence is p + 1; the pop then sets it to p + size,
+ * freeing it for the next lap. Producers and consumers each claim positions
+ * with one CAS on their own index, so any number of either can share a ring
+ * and a full or empty ring is seen without locks. Waiting threads yield, then
+ * sleep briefly, so idle stages don't hold a CPU.
+ */
+
+/* Yields before a waiting thread starts sleeping, and the sleep */
+#define RING_YIELDS     16
+#define RING_SLEEP      20000L
+
+/* A slot of the ring */
+typedef struct {
+    atomic_size_t sequence;
+    void *item;
+} Cell;
+
+/* Structure representing a ring (indices on their own cache lines) */
+struct ring {
+    _Alignas(64) atomic_size_t tail;    // Next position to push.
+    _Alignas(64) atomic_size_t head;    // Next position to pop.
+    _Alignas(64) atomic_int producers;
+    size_t mask;
+    Cell *cells;
+};
+
+/*
+ ******************************************************************************
+ *                             Private Functions
+ ******************************************************************************
+ */
+
+/* Adds 'item' if there is room. Returns nonzero if it was added */
+static int tryPush (Ring *r, void *item) {
+    size_t position = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    for (;;) {
+        Cell *cell = &r->cells[position & r->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->tail, &position, position + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                cell->item = item;
+                atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+                return 1;
+            }
+        } else if (difference < 0) {
+            return 0;
+        } else {
+            position = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        }
+    }
+}
+
+/* Waits a little longer each round */
+static void backOff (int round) {
+    if (round < RING_YIELDS) {
+        sched_yield();
+    } else {
+        struct timespec pause = {0, RING_SLEEP};
+        nanosleep(&pause, NULL);
+    }
+}
+
+/*
+ ******************************************************************************
+ *                              Public Functions
+ ******************************************************************************
+ */
+
+/* Creates a ring of at least 'capacity' items. Returns NULL on failure */
+Ring *ringCreate (long capacity, int producers) {
+    size_t size = 1;
+    Ring *r;
+
+    while ((long)size < capacity) {
+        size <<= 1;
+    }
+    if ((r = aligned_alloc(64, sizeof(Ring))) == NULL) {
+        return NULL;
+    }
+    if ((r->cells = malloc(size * sizeof(Cell))) == NULL) {
+        free(r);
+        return NULL;
+    }
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&r->cells[i].sequence, i);
+    }
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->head, 0);
+    atomic_init(&r->producers, producers);
+    r->mask = size - 1;
+    return r;
+}
+
+/* Adds 'item', waiting while the ring is full */
+void ringPush (Ring *r, void *item, long long *waitNanos) {
+    long long start;
+
+    if (tryPush(r, item)) {
+        return;
+    }
+    start = statsNanos();
+    for (int round = 0; !tryPush(r, item); round++) {
+        backOff(round);
+    }
+    *waitNanos += statsNanos() - start;
+}
+
+/* Removes the oldest item without waiting. Returns NULL if there is none */
+void *ringTryPop (Ring *r) {
+    size_t position = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+    for (;;) {
+        Cell *cell = &r->cells[position & r->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->head, &position, position + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                void *item = cell->item;
+                atomic_store_explicit(&cell->sequence, position + r->mask + 1,
+                                      memory_order_release);
+                return item;
+            }
+        } else if (difference < 0) {
+            return NULL;
+        } else {
+            position = atomic_load_explicit(&r->head, memory_order_relaxed);
+        }
+    }
+}
+
+/* Removes the oldest item, waiting while the ring is empty */
+void *ringPop (Ring *r, long long *waitNanos, long *depth) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    long long start = 0;
+    void *item;
+
+    *depth += tail > head ? (long)(tail - head) : 0;
+    for (int round = 0; (item = ringTryPop(r)) == NULL; round++) {
+
+        // Items pushed before the last producer left are still taken.
+        if (atomic_load_explicit(&r->producers, memory_order_acquire) == 0) {
+            item = ringTryPop(r);
+            break;
+        }
+        if (round == 0) {
+            start = statsNanos();
+        }
+        backOff(round);
+    }
+    if (start != 0) {
+        *waitNanos += statsNanos() - start;
+    }
+    return item;
+}
+
+/* Marks one producer as finished */
+void ringDetach (Ring *r) {
+    atomic_fetch_sub_explicit(&r->producers, 1, memory_order_release);
+}
+
+/* Returns the number of items the ring holds */
+long ringCapacity (const Ring *r) {
+    return (long)r->mask + 1;
+}
+
+/* Frees the ring */
+void ringDestroy (Ring *r) {
+    if (r != NULL) {
+        free(r->cells);
+        free(r);
+    }
+}
@@ -0,0 +1,56 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateRing.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Bounded lock-free rings passing pointers between threads.
+********************************************************************************
+*/
+
+#include <stddef.h>
+
+#if !defined(duplicateRing_h)
+#define duplicateRing_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Opaque ring handle */
+typedef struct ring Ring;
+
+/*
+ ******************************************************************************
+ *                                  Prototypes
+ ******************************************************************************
+ */
+
+ /* Creates a ring of at least 'capacity' items (rounded up to a power of two),
+  * fed by 'producers' threads. Returns NULL on failure */
+ Ring *ringCreate (long capacity, int producers);
+
+ /* Adds 'item' (not NULL), waiting while the ring is full. The time spent
+  * waiting is added to '*waitNanos' */
+ void ringPush (Ring *r, void *item, long long *waitNanos);
+
+ /* Removes the oldest item, waiting while the ring is empty. Returns NULL once
+  * every producer has detached and the ring is drained. The time spent waiting
+  * is added to '*waitNanos', and the items found waiting to '*depth' */
+ void *ringPop (Ring *r, long long *waitNanos, long *depth);
+
+ /* Removes the oldest item without waiting. Returns NULL if there is none */
+ void *ringTryPop (Ring *r);
+
+ /* Marks one producer as finished */
+ void ringDetach (Ring *r);
+
+ /* Returns the number of items the ring holds */
+ long ringCapacity (const Ring *r);
+
+ /* Frees the ring (its items are the caller's) */
+ void ringDestroy (Ring *r);
+
+#endif
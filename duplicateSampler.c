@@ -0,0 +1,389 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateSampler.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Budgeted random subtree sampling with extrapolated estimates.
+********************************************************************************
+*/
+
+#include "duplicateSampler.h"
+#include "duplicateStatistics.h"
+#include "duplicateProgress.h"
+#include "duplicateLimiter.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <math.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/*
+ * A probe walks from the (virtual) root to a leaf, stepping into a random
+ * subdirectory chosen with probability proportional to its entry count + 1.
+ * Every directory on the way contributes its totals weighted by the inverse of
+ * the probability of reaching it, which makes each probe an unbiased estimate
+ * of the whole tree (Knuth's estimator, with size-weighted choices to lower
+ * its variance). Probes are independent, so their spread gives the intervals.
+ */
+
+/* A directory seen by the sampler */
+typedef struct sampleDir {
+    char *path;
+    long entries;                       // -1 until counted.
+    int expanded;                       // Files tracked, children listed.
+    double value[SAMPLE_METRICS];       // Totals of its own files.
+    struct sampleDir **children;
+    long childCount, childCapacity;
+    struct sampleDir *nextExpanded;     // All expanded directories.
+    struct sampleDir *nextBucket;       // Path lookup chain.
+} SampleDir;
+
+/* A directory visited by a probe, with its weight */
+typedef struct {
+    SampleDir *dir;
+    double weight;
+} ProbeStep;
+
+/* Sampler state */
+typedef struct {
+    Tracker *tracker;
+    SampleDir root, *expanded;
+    ProbeStep *steps;
+    long stepCount, stepCapacity;
+    long *probeEnds, probeCapacity;     // Step count at the end of each probe.
+    SampleEstimate *estimate;
+} Sampler;
+
+/*
+ ******************************************************************************
+ *                             Auxillary Functions
+ ******************************************************************************
+ */
+
+/* Grows '*array' of 'size' byte elements to hold 'count' + 1. Signals error with nonzero value */
+static int reserve (void **array, long *capacity, long count, size_t size) {
+    if (count == *capacity) {
+        long grown = *capacity ? 2 * *capacity : 16;
+        void *p = realloc(*array, grown * size);
+        if (p == NULL) {
+            return 1;
+        }
+        *array = p;
+        *capacity = grown;
+    }
+    return 0;
+}
+
+/* Adds a child directory 'name' to 'parent' (NULL path: 'name' is a root) */
+static int addChild (SampleDir *parent, const char *name) {
+    SampleDir *d;
+
+    if (reserve((void **)&parent->children, &parent->childCapacity,
+                parent->childCount, sizeof(SampleDir *)) ||
+        (d = calloc(1, sizeof(SampleDir))) == NULL) {
+        return 1;
+    }
+    if (parent->path == NULL) {
+        d->path = strdup(name);
+    } else if ((d->path = malloc(strlen(parent->path) + strlen(name) + 2)) != NULL) {
+        sprintf(d->path, "%s/%s", parent->path, name);
+    }
+    if (d->path == NULL) {
+        free(d);
+        return 1;
+    }
+    d->entries = -1;
+    parent->children[parent->childCount++] = d;
+    return 0;
+}
+
+/* Frees a directory's descendants */
+static void freeChildren (SampleDir *d) {
+    for (long i = 0; i < d->childCount; i++) {
+        freeChildren(d->children[i]);
+        free(d->children[i]->path);
+        free(d->children[i]);
+    }
+    free(d->children);
+}
+
+/* Returns the number of entries in 'd' (excluding self, parent), counting once */
+static long countEntries (SampleDir *d) {
+    struct dirent *entry;
+    DIR *directory;
+
+    if (d->entries >= 0) {
+        return d->entries;
+    }
+    d->entries = 0;
+    limiterAcquire(LIMIT_DIRS, 1);
+    if ((directory = opendir(d->path)) == NULL) {
+        return 0;
+    }
+    while ((entry = readdir(directory)) != NULL) {
+        limiterAcquire(LIMIT_BYTES, entry->d_reclen);
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            d->entries++;
+        }
+    }
+    closedir(directory);
+    return d->entries;
+}
+
+/* Tracks the files of 'd' and lists its subdirectories. Signals error with nonzero value */
+static int expandDir (Sampler *s, SampleDir *d) {
+    char pathName[MAX_PATH];
+    struct dirent *entry;
+    struct stat statBuffer;
+    DIR *directory;
+
+    d->expanded = 1;
+    d->nextExpanded = s->expanded;
+    s->expanded = d;
+    s->estimate->directories++;
+    PROGRESS_ADD(progressDirs, 1);
+
+    limiterAcquire(LIMIT_DIRS, 1);
+    if ((directory = opendir(d->path)) == NULL) {
+        fprintf(stderr, "Error: Can't access directory %s! -Ignoring-\n", d->path);
+        return 0;
+    }
+    STAT_ADD(STAT_DIRS_OPENED, 1);
+
+    while ((entry = readdir(directory)) != NULL) {
+        limiterAcquire(LIMIT_BYTES, entry->d_reclen);
+        STAT_ADD(STAT_ENTRIES_READ, 1);
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+
+        // Directories are known from the entry type, everything else is stat'ed.
+        if (entry->d_type == DT_DIR) {
+            if (addChild(d, entry->d_name)) {
+                closedir(directory);
+                return 1;
+            }
+            continue;
+        }
+        if (snprintf(pathName, MAX_PATH, "%s/%s", d->path, entry->d_name) >= MAX_PATH) {
+            fprintf(stderr, "Error: %s filepath too long! -Ignoring-\n", entry->d_name);
+            continue;
+        }
+        limiterAcquire(LIMIT_STATS, 1);
+        STAT_ADD(STAT_STATS_ISSUED, 1);
+        if (stat(pathName, &statBuffer) == -1) {
+            STAT_ADD(STAT_STAT_ERRORS, 1);
+            fprintf(stderr, "Error: Can't access file %s! -Ignoring-\n", pathName);
+        } else if (S_ISDIR(statBuffer.st_mode)) {
+            if (addChild(d, entry->d_name)) {
+                closedir(directory);
+                return 1;
+            }
+        } else if (trackerInsert(s->tracker, pathName, statBuffer.st_mtime,
+                                 statBuffer.st_size)) {
+            fprintf(stderr, "Error: File couldn't be logged! -Ignoring-\n");
+        } else {
+            d->value[SAMPLE_FILES] += 1;
+            d->value[SAMPLE_BYTES] += statBuffer.st_size;
+            s->estimate->files++;
+            PROGRESS_ADD(progressFiles, 1);
+        }
+    }
+
+    closedir(directory);
+    return 0;
+}
+
+/* Walks one random path from the root down. Signals error with nonzero value */
+static int probe (Sampler *s) {
+    SampleDir *d = &s->root;
+    double weight = 1.0;
+
+    for (;;) {
+        double total = 0.0, u;
+        long i;
+
+        if (!d->expanded && expandDir(s, d)) {
+            return 1;
+        }
+        if (reserve((void **)&s->steps, &s->stepCapacity, s->stepCount, sizeof(ProbeStep))) {
+            return 1;
+        }
+        s->steps[s->stepCount++] = (ProbeStep){d, weight};
+        if (d->childCount == 0) {
+            break;
+        }
+
+        // Choose a subdirectory with probability (entries + 1) / total.
+        for (i = 0; i < d->childCount; i++) {
+            total += countEntries(d->children[i]) + 1;
+        }
+        u = drand48() * total;
+        for (i = 0; i < d->childCount - 1; i++) {
+            if ((u -= d->children[i]->entries + 1) < 0) {
+                break;
+            }
+        }
+        d = d->children[i];
+        weight *= total / (d->entries + 1);
+    }
+
+    if (reserve((void **)&s->probeEnds, &s->probeCapacity, s->estimate->probes, sizeof(long))) {
+        return 1;
+    }
+    s->probeEnds[s->estimate->probes++] = s->stepCount;
+    return 0;
+}
+
+/* Charges duplicates and wasted bytes found in the sample to their directories */
+static int countDuplicates (Sampler *s) {
+    char directory[MAX_PATH];
+    SampleDir **table, *d;
+    TrackerIterator it;
+    GroupView group;
+    FileView file;
+    long buckets = 1;
+
+    // Index expanded directories by path.
+    while (buckets < 2 * s->estimate->directories) {
+        buckets <<= 1;
+    }
+    if ((table = calloc(buckets, sizeof(SampleDir *))) == NULL) {
+        return 1;
+    }
+    for (d = s->expanded; d != NULL; d = d->nextExpanded) {
+        if (d->path != NULL) {
+            long b = trackerHash(d->path) & (buckets - 1);
+            d->nextBucket = table[b];
+            table[b] = d;
+        }
+    }
+
+    // Members come newest first: the rest of each group is waste.
+    trackerBegin(s->tracker, NULL, &it);
+    while (trackerNextGroup(&it, &group)) {
+        int newest = 1;
+        if (group.count < 2) {
+            continue;
+        }
+        while (trackerNextMember(&it, &file)) {
+            memcpy(directory, file.directory, file.directoryLength);
+            directory[file.directoryLength] = '\0';
+            for (d = table[trackerHash(directory) & (buckets - 1)]; d != NULL; d = d->nextBucket) {
+                if (strcmp(d->path, directory) == 0) {
+                    d->value[SAMPLE_DUPLICATES] += 1;
+                    d->value[SAMPLE_WASTED] += newest ? 0 : file.size;
+                    break;
+                }
+            }
+            newest = 0;
+        }
+    }
+
+    free(table);
+    return 0;
+}
+
+/* Turns the probes into estimates with confidence intervals */
+static void extrapolate (Sampler *s) {
+    SampleEstimate *e = s->estimate;
+    double sum[SAMPLE_METRICS] = {0}, squares[SAMPLE_METRICS] = {0};
+    long step = 0;
+
+    for (SampleDir *d = s->expanded; d != NULL; d = d->nextExpanded) {
+        for (int m = 0; m < SAMPLE_METRICS; m++) {
+            e->sampled[m] += d->value[m];
+        }
+    }
+
+    for (long p = 0; p < e->probes; p++) {
+        double total[SAMPLE_METRICS] = {0};
+        for (; step < s->probeEnds[p]; step++) {
+            for (int m = 0; m < SAMPLE_METRICS; m++) {
+                total[m] += s->steps[step].weight * s->steps[step].dir->value[m];
+            }
+        }
+        for (int m = 0; m < SAMPLE_METRICS; m++) {
+            sum[m] += total[m];
+            squares[m] += total[m] * total[m];
+        }
+    }
+
+    for (int m = 0; m < SAMPLE_METRICS && e->probes > 0; m++) {
+        double mean = sum[m] / e->probes, variance = 0.0;
+        if (e->probes > 1) {
+            variance = (squares[m] - e->probes * mean * mean) / (e->probes - 1);
+        }
+        e->estimate[m] = mean;
+        e->error[m] = SAMPLE_Z * sqrt(variance > 0 ? variance / e->probes : 0);
+    }
+}
+
+/*
+ ******************************************************************************
+ *                             Public Functions
+ ******************************************************************************
+ */
+
+/* Samples the trees under 'roots' until 'budget' runs out */
+int sampleScan (Tracker *t, const char * const *roots, long count,
+                const SampleBudget *budget, SampleEstimate *estimate) {
+    double seconds = budget->seconds > 0 ? budget->seconds : SAMPLE_SECONDS;
+    long probes = budget->probes > 0 ? budget->probes : SAMPLE_PROBES;
+    long long deadline = statsNanos() + (long long)(seconds * 1e9);
+    Sampler s = {.tracker = t, .estimate = estimate};
+    struct stat statBuffer;
+    int status = 0;
+
+    memset(estimate, 0, sizeof(*estimate));
+    estimate->seed = budget->seed ? budget->seed : (long)time(NULL);
+    srand48(estimate->seed);
+
+    // The virtual root's children are the given directories.
+    s.root.expanded = 1;
+    for (long i = 0; i < count; i++) {
+        if (stat(roots[i], &statBuffer) == -1 || !S_ISDIR(statBuffer.st_mode)) {
+            fprintf(stderr, "Error: %s isn't a directory! -Ignoring-\n", roots[i]);
+        } else if (addChild(&s.root, roots[i])) {
+            status = 1;
+        }
+    }
+
+    // Probe until the budget runs out (but at least twice, for an interval).
+    while (status == 0 && s.root.childCount > 0 && estimate->probes < probes &&
+           (estimate->probes < 2 ||
+            (statsNanos() < deadline && (budget->files == 0 || estimate->files < budget->files)))) {
+        status = probe(&s);
+    }
+
+    if (status == 0 && (status = countDuplicates(&s)) == 0) {
+        extrapolate(&s);
+    }
+
+    freeChildren(&s.root);
+    free(s.steps);
+    free(s.probeEnds);
+    return status || s.root.childCount == 0;
+}
+
+/* Prints the estimates with their confidence intervals */
+void printSampleEstimate (FILE *out, const SampleEstimate *e) {
+    static const char *labels[SAMPLE_METRICS] = {
+        "files", "bytes", "duplicate files", "wasted bytes"
+    };
+
+    fprintf(out, "Sample: %ld probes, %ld directories, %ld files (seed %ld)\n",
+            e->probes, e->directories, e->files, e->seed);
+    fprintf(out, "%-16s %14s %14s   %s\n", "", "sampled", "estimate", "95% interval");
+    for (int m = 0; m < SAMPLE_METRICS; m++) {
+        fprintf(out, "%-16s %14.0f %14.4g   +/- %.3g\n", labels[m],
+                e->sampled[m], e->estimate[m], e->error[m]);
+    }
+    fprintf(out, "Note: duplicates are counted within the sample, so the duplicate and\n"
+                 "      wasted byte estimates are lower bounds.\n");
+}
@@ -0,0 +1,72 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateSampler.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Budgeted random subtree sampling with extrapolated estimates.
+********************************************************************************
+*/
+
+#include "duplicateTracker.h"
+
+#if !defined(duplicateSampler_h)
+#define duplicateSampler_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Default budget: seconds, and probes (random root-to-leaf walks) */
+#define SAMPLE_SECONDS      300
+#define SAMPLE_PROBES       1000
+
+/* Normal quantile of the reported confidence intervals (95%) */
+#define SAMPLE_Z            1.96
+
+/* Estimated quantities */
+typedef enum {
+    SAMPLE_FILES,           // Files.
+    SAMPLE_BYTES,           // Bytes in files.
+    SAMPLE_DUPLICATES,      // Files sharing their name with another sampled file.
+    SAMPLE_WASTED,          // Bytes in such files other than each name's newest.
+    SAMPLE_METRICS
+} SampleMetric;
+
+/* Sampling budget (zero fields take defaults, except 'files': unlimited) */
+typedef struct {
+    double seconds;
+    long files;             // Stop once this many files are sampled.
+    long probes;
+    long seed;
+} SampleBudget;
+
+/* Sampling results */
+typedef struct {
+    long probes, directories, files;    // Sample size.
+    long seed;
+    double sampled[SAMPLE_METRICS];     // Totals within the sample itself.
+    double estimate[SAMPLE_METRICS];    // Extrapolated totals.
+    double error[SAMPLE_METRICS];       // Half-width of their confidence intervals.
+} SampleEstimate;
+
+/*
+ ******************************************************************************
+ *                                  Prototypes
+ ******************************************************************************
+ */
+
+ /*
+  * Samples the trees under 'roots' until 'budget' runs out, tracking sampled
+  * files in 't', and extrapolates totals into 'estimate'. Signals error with
+  * nonzero value.
+  */
+ int sampleScan (Tracker *t, const char * const *roots, long count,
+                 const SampleBudget *budget, SampleEstimate *estimate);
+
+ /* Prints the estimates with their confidence intervals */
+ void printSampleEstimate (FILE *out, const SampleEstimate *estimate);
+
+#endif
@@ -9,11 +9,25 @@
 */
 
 #include "duplicateTracker.h"
+#include "duplicateStatistics.h"
+#include "duplicateProgress.h"
+#include "duplicateMemory.h"
+#include "duplicateProbes.h"
+#include "duplicateCheckpoint.h"
+#include "duplicateLimiter.h"
+#include "duplicateSampler.h"
+#include "duplicateRing.h"
+#include "duplicateServer.h"
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/dir.h>
 #include <dirent.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <poll.h>
 
 /*
  ******************************************************************************
@@ -26,23 +40,173 @@
 
 /* Program usage */
 #define PRGM_USE    "(Type/Drag) in directories to scan delimited by spaces.\n"\
-                    "\tI.E: ./duplicateScanner <dir1> <dir2> ... <dirN>\n"
+                    "\tI.E: ./duplicateScanner [options] <dir1> <dir2> ... <dirN>\n"\
+                    "\t--stats          Print per-phase counters and timers on exit\n"\
+                    "\t--stats=<file>   Write them to <file> as JSON instead\n"\
+                    "\t--progress       Show live progress (default on a terminal)\n"\
+                    "\t--no-progress    Don't show live progress\n"\
+                    "\t--verbose        Trace every directory as it is scanned\n"\
+                    "\t--memory         Print memory used per data structure\n"\
+                    "\t--estimate=<n>   Dry run: scan the given (sample) directories,\n"\
+                    "\t                 print the memory <n> files would need, exit\n"\
+                    "\t--diagnostics    Print hash table distribution diagnostics\n"\
+                    "\t--save-index=<f> Save the scanned files to index file <f>\n"\
+                    "\t--load-index=<f> Load index file <f> (directories optional)\n"\
+                    "\t--min-count=<n>  Only report names with at least <n> files\n"\
+                    "\t--min-size=<n>   Only report files of at least <n> bytes\n"\
+                    "\t--report-threads=<n> Format the report with <n> threads (one per CPU)\n"\
+                    "\t--sort=<order>   Report names by name, count, wasted (bytes) or newest\n"\
+                    "\t--checkpoint=<f> Periodically checkpoint the scan to journal <f>\n"\
+                    "\t--checkpoint-interval=<s> Seconds between checkpoints (60)\n"\
+                    "\t--resume         Continue from the last checkpoint in <f>\n"\
+                    "\t--max-stats=<n>  Issue at most <n> stat calls per second\n"\
+                    "\t--max-dirs=<n>   Open at most <n> directories per second\n"\
+                    "\t--max-bytes=<n>  Read at most <n> directory bytes per second\n"\
+                    "\t--max-latency=<ms> Back off while stat latency exceeds <ms>\n"\
+                    "\t--limit-file=<f> Read limits from <f>, again on every SIGHUP\n"\
+                    "\t--idle-io        Scan in the idle I/O priority class\n"\
+                    "\t--sample         Sample random subtrees and extrapolate totals\n"\
+                    "\t--sample-seconds=<s> Time budget of the sample (300)\n"\
+                    "\t--sample-files=<n>   File budget of the sample (unlimited)\n"\
+                    "\t--sample-probes=<n>  Random walks to take at most (1000)\n"\
+                    "\t--sample-seed=<n>    Random seed (default: the time)\n"\
+                    "\t--shard=<i>/<n>  Scan only shard <i> (0..n-1) of the top-level entries\n"\
+                    "\t--merge=<f>      Merge the given index files into index <f>, exit\n"\
+                    "\t--diff           Print duplicate changes between two given indexes, exit\n"\
+                    "\t--pipeline=<e>,<m>,<k> Scan in stages with <e> directory reading,\n"\
+                    "\t                 <m> stat and <k> key threads (and one inserting)\n"\
+                    "\t--stream=<f>     Write duplicates to <f> ('-': stdout) as they are found\n"\
+                    "\t--live           Answer 's <name>' and 'c' (counts) lines while scanning\n"\
+                    "\t--serve=<s>      Answer queries on Unix socket <s> after the scan, until\n"\
+                    "\t                 SIGINT or SIGTERM (instead of the menu)\n"
 
 /* Program options */
 #define PRGM_SRH    's'
 #define PRGM_ALL    'a'
 #define PRGM_EXT    'q'
 
+/* Live query for the counts so far, and how often the live thread checks the scan */
+#define LIVE_COUNT  'c'
+#define LIVE_POLL   100
+
 #define PRGM_OPT    "\n- Search duplicates by name: s\n"\
                     "- Print file table contents: a\n"\
                     "- Quit (cleanly)           : q\n"
 
+/* Records per pipeline batch, bytes of path text per batch, batches per ring */
+#define BATCH_RECORDS   256
+#define BATCH_TEXT      (64 * 1024)
+#define RING_BATCHES    16
+
+/* What a pipeline record turned out to be */
+enum {
+    RECORD_FILE,
+    RECORD_DIRECTORY,
+    RECORD_SKIPPED
+};
+
+/* Records passed between pipeline stages. Each path is followed by room for
+ * its key, in case the key policy changes the name */
+typedef struct {
+    int count;
+    size_t used;
+    TrackerRecord records[BATCH_RECORDS];
+    char kinds[BATCH_RECORDS];
+    char text[BATCH_TEXT];
+} Batch;
+
 /* Directory Entry: Filename and inode */
 typedef struct {
     long index;
     char fileName[NAME_MAX + 1];
 } DirEntry;
 
+/* Output of a live query */
+typedef struct {
+    FILE *out;
+    int index;
+} LiveMatch;
+
+
+/* The tracker all scanned files are logged in */
+static Tracker *tracker;
+
+/* Destination of --stats=<file>, NULL to print to stderr */
+static const char *statsPath;
+
+/* Nonzero to trace directories (--verbose), show progress (-1: if a tty) */
+static int verbose, showProgress = -1;
+
+/* Nonzero to print the memory report (--memory), projected file count */
+static int memoryReport;
+static long estimateFiles;
+
+/* Nonzero to print table diagnostics, index files to save to and load from */
+static int diagnostics;
+static const char *saveIndexPath, *loadIndexPath;
+
+/* Filter applied to the file table report, threads formatting it (0: default) */
+static TrackerFilter reportFilter;
+static int reportThreads;
+
+/* Order of the file table report, and the --sort names of each order */
+static ReportOrder reportOrder;
+static const char *orderNames[] = {"table", "name", "count", "wasted", "newest"};
+
+/* Checkpoint journal, seconds between checkpoints, nonzero to resume */
+static const char *checkpointPath;
+static long checkpointInterval;
+static int resume;
+
+/* Nonzero to scan in the idle I/O class, limit control file */
+static int idleIO;
+static const char *limitPath;
+
+/* Nonzero to sample instead of scanning everything, and the sample budget */
+static int sampling;
+static SampleBudget sampleBudget;
+
+/* Shard to scan (of 'shardCount', 0: all), merged index to write */
+static long shardIndex, shardCount;
+static const char *mergePath;
+
+/* Nonzero to compare two index files */
+static int diffing;
+
+/* Where duplicates are written as they are found (--stream) */
+static const char *streamPath;
+static FILE *streamOut;
+
+/* Nonzero to answer queries while scanning (--live), and while the scan runs */
+static int live;
+static atomic_int scanning;
+
+/* Unix socket to answer queries on after the scan (--serve) */
+static const char *servePath;
+
+/* Directories waiting to be scanned (LIFO, keeps the walk depth-first) */
+static char **pendingDirectories;
+static long pendingCount, pendingCapacity;
+static pthread_mutex_t pendingLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * A pipelined scan (--pipeline) runs enumerate -> metadata -> key -> insert
+ * stages in their own threads, passing batches of records through bounded
+ * lock-free rings. Batches come from a fixed pool and go back to it once
+ * inserted, so a slow stage stalls the ones before it instead of using
+ * memory. Directories found by the metadata stage go back to the pending
+ * stack. 'outstanding' counts the directories pending or being read and the
+ * batches not yet statted: the walk is over when it drops to zero.
+ */
+
+/* Threads of the enumerate, metadata and key stages (0: scan in one thread) */
+static int stageThreads[STAGE_INSERT];
+
+/* The input ring of each stage after the first, and the pool of free batches */
+static Ring *stageInput[STAGE_COUNT], *freeBatches;
+
+/* Directories and batches the walk is still waiting for */
+static atomic_long outstanding;
 
 /* Forward declarations (Prototypes) */
 void scanDirectory (const char *, void (*)(const char *));
@@ -57,7 +221,15 @@ void scanDirectory (const char *, void (*)(const char *));
 
 /* Allocates a DIR object for readDirectory calls (System dependent). */
 DIR *openDirectory (const char *directoryName) {
-    return opendir(directoryName);
+    limiterAcquire(LIMIT_DIRS, 1);
+    STAT_BEGIN(start);
+    DIR *directory = opendir(directoryName);
+    STAT_END(PHASE_OPENDIR, start);
+
+    if (directory != NULL) {
+        STAT_ADD(STAT_DIRS_OPENED, 1);
+    }
+    return directory;
 }
 
 /* Frees a DIR object (System dependent). */
@@ -72,7 +244,8 @@ void closeDirectory (DIR *directory) {
 /* Returns consecutive directory-entries from a directory stream */
 DirEntry *readDirectoryEntry (DIR *directory) {
     struct dirent *entryBuffer; // Standard buffer size of entry in DIR.
-    static DirEntry entry;
+    static _Thread_local DirEntry entry;
+    STAT_BEGIN(start);
 
     // Repeatedly write entries to the buffer while the byte count aligns.
     while ((entryBuffer = readdir(directory)) != NULL) {
@@ -82,12 +255,16 @@ DirEntry *readDirectoryEntry (DIR *directory) {
             continue;
         }
 
+        limiterAcquire(LIMIT_BYTES, entryBuffer->d_reclen);
         entry.index = entryBuffer->d_ino;
         strncpy(entry.fileName, entryBuffer->d_name, NAME_MAX);
         entry.fileName[NAME_MAX] = '\0';
+        STAT_END(PHASE_READDIR, start);
+        STAT_ADD(STAT_ENTRIES_READ, 1);
         return &entry;
     }
 
+    STAT_END(PHASE_READDIR, start);
     return NULL;
 }
 
@@ -97,26 +274,155 @@ DirEntry *readDirectoryEntry (DIR *directory) {
  ******************************************************************************
  */
 
+/* Queues a directory for scanning. Signals error with nonzero value */
+int pushDirectory (const char *directoryName) {
+    char *copy;
+
+    if ((copy = strdup(directoryName)) == NULL) {
+        return 1;
+    }
+    pthread_mutex_lock(&pendingLock);
+
+    // Grow the stack by doubling.
+    if (pendingCount == pendingCapacity) {
+        long capacity = pendingCapacity ? 2 * pendingCapacity : 64;
+        char **grown = realloc(pendingDirectories, capacity * sizeof(char *));
+        if (grown == NULL) {
+            pthread_mutex_unlock(&pendingLock);
+            free(copy);
+            return 1;
+        }
+        pendingDirectories = grown;
+        pendingCapacity = capacity;
+    }
+
+    atomic_fetch_add_explicit(&outstanding, 1, memory_order_relaxed);
+    pendingDirectories[pendingCount++] = copy;
+    pthread_mutex_unlock(&pendingLock);
+    PROGRESS_ADD(progressPending, 1);
+    return 0;
+}
+
+/* Removes the next directory to scan (caller frees), NULL if none remain. The
+ * directories left are added to '*depth' */
+char *popDirectory (long *depth) {
+    char *directoryName = NULL;
+
+    pthread_mutex_lock(&pendingLock);
+    if (pendingCount > 0) {
+        directoryName = pendingDirectories[--pendingCount];
+        *depth += pendingCount;
+        PROGRESS_ADD(progressPending, -1);
+    }
+    pthread_mutex_unlock(&pendingLock);
+    return directoryName;
+}
+
+/* Stats a file within the rate limits. Returns the status of stat */
+int statFile (const char *fileName, struct stat *statBuffer) {
+    limiterAcquire(LIMIT_STATS, 1);
+    int limited = atomic_load_explicit(&limiterActive, memory_order_relaxed);
+    long long issued = limited ? statsNanos() : 0;
+    STAT_BEGIN(start);
+    PROBE_STAT_START(fileName);
+    int status = stat(fileName, statBuffer);
+    PROBE_STAT_DONE(fileName, strlen(fileName), status);
+    STAT_END(PHASE_STAT, start);
+    if (limited) {
+        limiterStatLatency(statsNanos() - issued);
+    }
+    STAT_ADD(STAT_STATS_ISSUED, 1);
+    if (status == -1) {
+        STAT_ADD(STAT_STAT_ERRORS, 1);
+        fprintf(stderr, "Error: Can't access file %s! -Ignoring-\n", fileName);
+    }
+    return status;
+}
+
+/* Writes a duplicate file as a line of tab separated fields: the group's file
+ * count so far, size, mtime, key and path */
+void streamDuplicate (void *out, const char *key, long count, const FileView *file) {
+    fprintf(out, "%ld\t%llu\t%lld\t%s\t%s\n", count, (unsigned long long)file->size,
+            (long long)file->modified, key, file->path);
+}
+
+/* Makes the duplicates streamed so far visible to readers */
+void flushStream (void) {
+    if (streamOut != NULL) {
+        fflush(streamOut);
+    }
+}
+
 /* Prints last modified date of file to standard out. If dir, dir is walked. */
 void scanFile (const char *fileName) {
     struct stat statBuffer; // For use with stat()
 
     // System call to stat to get file info.
-    if (stat(fileName, &statBuffer) == -1) {
-        fprintf(stderr, "Error: Can't access file %s! -Ignoring-\n", fileName);
+    if (statFile(fileName, &statBuffer) == -1) {
         return;
     }
 
-    // If directory, recursively apply scanFile to contents.
+    // If directory, queue it so scanPending applies scanFile to contents.
     if ((statBuffer.st_mode & S_IFMT) == S_IFDIR) {
-        fprintf(stdout, "\tNote: Scanning directory %s\n", fileName);
-        scanDirectory(fileName, scanFile);
+        if (pushDirectory(fileName)) {
+            fprintf(stderr, "Error: Can't queue directory %s! -Ignoring-\n", fileName);
+        }
     } else {
         time_t modified = statBuffer.st_mtime;
 
         // Track file in file table.
-        if (trackFile(fileName, modified)) {
+        if (trackerInsert(tracker, fileName, modified, statBuffer.st_size)) {
             fprintf(stderr, "Error: File couldn't be logged! -Ignoring-\n");
+        } else if (checkpointRecord(fileName, modified, statBuffer.st_size)) {
+            fprintf(stderr, "Error: File couldn't be journaled!\n");
+        }
+        PROGRESS_ADD(progressFiles, 1);
+    }
+}
+
+/* Scans a top-level entry if it belongs to this process' shard */
+void scanShardEntry (const char *fileName) {
+    const char *name = strrchr(fileName, '/') + 1;
+
+    // Entries are assigned by name, so shards agree wherever the root is mounted.
+    if ((long)(trackerHash(name) % shardCount) == shardIndex) {
+        scanFile(fileName);
+    }
+}
+
+/* Scans the part of a top-level directory in this process' shard */
+void scanShard (const char *directoryName) {
+    struct stat statBuffer;
+
+    // A top-level file belongs to the first shard.
+    if (stat(directoryName, &statBuffer) == 0 && !S_ISDIR(statBuffer.st_mode)) {
+        if (shardIndex == 0) {
+            scanFile(directoryName);
+        }
+        return;
+    }
+    scanDirectory(directoryName, scanShardEntry);
+}
+
+/* Scans queued directories until none remain */
+void scanPending (void) {
+    char *directoryName;
+    long depth = 0;
+
+    while ((directoryName = popDirectory(&depth)) != NULL) {
+        if (verbose) {
+            fprintf(stdout, "\tNote: Scanning directory %s\n", directoryName);
+        }
+        scanDirectory(directoryName, scanFile);
+        PROGRESS_ADD(progressDirs, 1);
+        atomic_fetch_sub_explicit(&outstanding, 1, memory_order_relaxed);
+        free(directoryName);
+        flushStream();
+        limiterPoll();
+
+        // Checkpoint between directories, where the frontier is exact.
+        if (checkpointDue() && checkpointCommit(pendingDirectories, pendingCount)) {
+            fprintf(stderr, "Error: Couldn't write checkpoint!\n");
         }
     }
 }
@@ -126,6 +432,7 @@ void scanDirectory (const char *directoryName, void (*f)(const char *)) {
     char pathName[MAX_PATH];
     DirEntry *entry;
     DIR *directory;
+    long entries = 0;
 
     // Open the directory.
     if ((directory = openDirectory(directoryName)) == NULL) {
@@ -133,10 +440,12 @@ void scanDirectory (const char *directoryName, void (*f)(const char *)) {
         directoryName);
         return;
     }
+    PROBE_DIR_OPEN(directoryName, strlen(directoryName));
 
     // Scan the directory contents.
     while ((entry = readDirectoryEntry(directory)) != NULL) {
         char *fileName = entry->fileName;
+        entries++;
 
         // Ignore self, parent.
         if (strcmp(fileName, ".") == 0 || strcmp(fileName, "..") == 0) {
@@ -154,53 +463,691 @@ void scanDirectory (const char *directoryName, void (*f)(const char *)) {
 
     // Close the directory.
     closeDirectory(directory);
+    PROBE_DIR_CLOSE(directoryName, entries);
+}
+
+/* Passes a batch to the next stage */
+void passBatch (Batch *batch, StatStage next, long long *wait, long *batches) {
+    ringPush(stageInput[next], batch, wait);
+    (*batches)++;
+}
+
+/* Reads a directory's entries into batches for the metadata stage. The
+ * current batch is kept in '*batch' (NULL if none) */
+void enumerateDirectory (const char *directoryName, Batch **batch, long long *wait,
+                         long *batches) {
+    size_t directoryLength = strlen(directoryName);
+    DirEntry *entry;
+    DIR *directory;
+    long entries = 0, unused = 0;
+
+    if (verbose) {
+        fprintf(stdout, "\tNote: Scanning directory %s\n", directoryName);
+    }
+    if ((directory = openDirectory(directoryName)) == NULL) {
+        fprintf(stderr, "Error: Can't access directory %s! -Ignoring-\n", directoryName);
+        return;
+    }
+    PROBE_DIR_OPEN(directoryName, directoryLength);
+
+    while ((entry = readDirectoryEntry(directory)) != NULL) {
+        size_t nameLength = strlen(entry->fileName), need;
+        TrackerRecord *record;
+        entries++;
+
+        // Ignore self, parent and over-long paths.
+        if (strcmp(entry->fileName, ".") == 0 || strcmp(entry->fileName, "..") == 0) {
+            continue;
+        }
+        if (directoryLength + nameLength + 2 > MAX_PATH) {
+            fprintf(stderr, "Error: %s filepath too long! -Ignoring-\n", entry->fileName);
+            continue;
+        }
+
+        // Start a new batch when this one is full (batches count as outstanding).
+        need = directoryLength + 2 * nameLength + 3;
+        if (*batch != NULL &&
+            ((*batch)->count == BATCH_RECORDS || (*batch)->used + need > BATCH_TEXT)) {
+            passBatch(*batch, STAGE_METADATA, wait, batches);
+            *batch = NULL;
+        }
+        if (*batch == NULL) {
+            *batch = ringPop(freeBatches, wait, &unused);
+            (*batch)->count = 0;
+            (*batch)->used = 0;
+            atomic_fetch_add_explicit(&outstanding, 1, memory_order_relaxed);
+        }
+
+        record = &(*batch)->records[(*batch)->count];
+        record->path = (*batch)->text + (*batch)->used;
+        record->pathLength = directoryLength + 1 + nameLength;
+        sprintf((char *)record->path, "%s/%s", directoryName, entry->fileName);
+        (*batch)->kinds[(*batch)->count++] = RECORD_FILE;
+        (*batch)->used += need;
+    }
+
+    closeDirectory(directory);
+    PROBE_DIR_CLOSE(directoryName, entries);
+}
+
+/* Enumerate stage: reads pending directories until the walk is over */
+void *enumerateStage (void *unused) {
+    long long begin = statsNanos(), wait = 0;
+    long batches = 0, depth = 0;
+    Batch *batch = NULL;
+    char *directoryName;
+
+    for (;;) {
+        if ((directoryName = popDirectory(&depth)) != NULL) {
+            enumerateDirectory(directoryName, &batch, &wait, &batches);
+            PROGRESS_ADD(progressDirs, 1);
+            atomic_fetch_sub_explicit(&outstanding, 1, memory_order_relaxed);
+            free(directoryName);
+            continue;
+        }
+
+        // Nothing to read: pass on the partial batch, it may hold directories.
+        if (batch != NULL) {
+            passBatch(batch, STAGE_METADATA, &wait, &batches);
+            batch = NULL;
+        }
+        if (atomic_load_explicit(&outstanding, memory_order_relaxed) == 0) {
+            break;
+        }
+        long long idle = statsNanos();
+        sched_yield();
+        wait += statsNanos() - idle;
+    }
+
+    ringDetach(stageInput[STAGE_METADATA]);
+    STAT_STAGE(STAGE_ENUMERATE, batches, statsNanos() - begin - wait, wait, depth);
+    if (statsEnabled) {
+        mergeThreadStatistics();
+    }
+    return unused;
+}
+
+/* Metadata stage: stats each record, queueing the directories found */
+void *metadataStage (void *unused) {
+    long long begin = statsNanos(), wait = 0;
+    long batches = 0, depth = 0;
+    Batch *batch;
+
+    while ((batch = ringPop(stageInput[STAGE_METADATA], &wait, &depth)) != NULL) {
+        for (int i = 0; i < batch->count; i++) {
+            TrackerRecord *record = &batch->records[i];
+            struct stat statBuffer;
+
+            if (statFile(record->path, &statBuffer) == -1) {
+                batch->kinds[i] = RECORD_SKIPPED;
+            } else if (S_ISDIR(statBuffer.st_mode)) {
+                batch->kinds[i] = RECORD_DIRECTORY;
+                if (pushDirectory(record->path)) {
+                    fprintf(stderr, "Error: Can't queue directory %s! -Ignoring-\n",
+                            record->path);
+                }
+            } else {
+                record->modified = statBuffer.st_mtime;
+                record->size = statBuffer.st_size;
+            }
+        }
+
+        // The batch's directories are queued, so it no longer holds the walk open.
+        atomic_fetch_sub_explicit(&outstanding, 1, memory_order_relaxed);
+        passBatch(batch, STAGE_KEY, &wait, &batches);
+    }
+
+    ringDetach(stageInput[STAGE_KEY]);
+    STAT_STAGE(STAGE_METADATA, batches, statsNanos() - begin - wait, wait, depth);
+    if (statsEnabled) {
+        mergeThreadStatistics();
+    }
+    return unused;
+}
+
+/* Key stage: computes the key and hash of each file, keeping only the files */
+void *keyStage (void *unused) {
+    long long begin = statsNanos(), wait = 0;
+    long batches = 0, depth = 0;
+    char buffer[NAME_MAX + 1];
+    Batch *batch;
+
+    while ((batch = ringPop(stageInput[STAGE_KEY], &wait, &depth)) != NULL) {
+        int files = 0;
+
+        for (int i = 0; i < batch->count; i++) {
+            TrackerRecord *record = &batch->records[i];
+
+            if (batch->kinds[i] != RECORD_FILE) {
+                continue;
+            }
+            if (trackerPrepare(tracker, record, buffer)) {
+                fprintf(stderr, "Error: File couldn't be logged! -Ignoring-\n");
+                continue;
+            }
+            if (record->key == buffer) {
+                char *key = (char *)record->path + record->pathLength + 1;
+                record->key = memcpy(key, buffer, record->keyLength + 1);
+            }
+            batch->records[files++] = *record;
+        }
+
+        // The insert stage merges the batch's files in one call.
+        batch->count = files;
+        passBatch(batch, STAGE_INSERT, &wait, &batches);
+    }
+
+    ringDetach(stageInput[STAGE_INSERT]);
+    STAT_STAGE(STAGE_KEY, batches, statsNanos() - begin - wait, wait, depth);
+    if (statsEnabled) {
+        mergeThreadStatistics();
+    }
+    return unused;
+}
+
+/* Insert stage (the calling thread): tracks the files, returning batches to the pool */
+void insertStage (void) {
+    long long begin = statsNanos(), wait = 0;
+    long batches = 0, depth = 0;
+    Batch *batch;
+
+    while ((batch = ringPop(stageInput[STAGE_INSERT], &wait, &depth)) != NULL) {
+        for (long failed = trackerInsertBatch(tracker, batch->records, batch->count);
+             failed > 0; failed--) {
+            fprintf(stderr, "Error: File couldn't be logged! -Ignoring-\n");
+        }
+        PROGRESS_ADD(progressFiles, batch->count);
+        ringPush(freeBatches, batch, &wait);
+        batches++;
+        flushStream();
+        limiterPoll();
+    }
+    STAT_STAGE(STAGE_INSERT, batches, statsNanos() - begin - wait, wait, depth);
+}
+
+/* Scans queued directories in pipeline stages. Signals error with nonzero
+ * value if the stages couldn't be started (nothing is scanned then) */
+int scanPipelined (void) {
+    void *(*stages[STAGE_INSERT])(void *) = {enumerateStage, metadataStage, keyStage};
+    long poolSize = 3 * RING_BATCHES + stageThreads[0] + stageThreads[1] + stageThreads[2];
+    pthread_t *threads[STAGE_INSERT] = {NULL};
+    int started[STAGE_INSERT] = {0}, failed = 0;
+    Batch **pool = calloc(poolSize, sizeof(Batch *));
+
+    // Set up the rings (each stage produces into the next one's) and the pool.
+    freeBatches = ringCreate(poolSize, 1);
+    failed = pool == NULL || freeBatches == NULL;
+    for (int stage = STAGE_METADATA; stage < STAGE_COUNT; stage++) {
+        stageInput[stage] = ringCreate(RING_BATCHES, stageThreads[stage - 1]);
+        failed |= stageInput[stage] == NULL;
+    }
+    for (long i = 0; !failed && i < poolSize; i++) {
+        if ((pool[i] = malloc(sizeof(Batch))) == NULL) {
+            failed = 1;
+        } else {
+            ringPush(freeBatches, pool[i], &(long long){0});
+        }
+    }
+
+    // Start the stages from the last, so a stage without threads has nothing before it.
+    for (int stage = STAGE_KEY; !failed && stage >= STAGE_ENUMERATE; stage--) {
+        threads[stage] = malloc(stageThreads[stage] * sizeof(pthread_t));
+        for (int i = 0; i < stageThreads[stage]; i++) {
+            if (threads[stage] != NULL &&
+                pthread_create(&threads[stage][started[stage]], NULL, stages[stage], NULL) == 0) {
+                started[stage]++;
+            } else {
+                ringDetach(stageInput[stage + 1]);
+            }
+        }
+        failed = started[stage] == 0;
+    }
+
+    // Insert until the stages drain, then collect them.
+    if (started[STAGE_KEY] > 0) {
+        insertStage();
+    }
+    for (int stage = STAGE_ENUMERATE; stage < STAGE_INSERT; stage++) {
+        for (int i = 0; i < started[stage]; i++) {
+            pthread_join(threads[stage][i], NULL);
+        }
+        free(threads[stage]);
+    }
+    for (long i = 0; pool != NULL && i < poolSize; i++) {
+        free(pool[i]);
+    }
+    free(pool);
+    ringDestroy(freeBatches);
+    for (int stage = STAGE_METADATA; stage < STAGE_COUNT; stage++) {
+        ringDestroy(stageInput[stage]);
+    }
+    return failed;
+}
+
+/* Prints a file a live query found, in the report's format */
+int printLiveMatch (void *context, const FileView *file) {
+    LiveMatch *match = context;
+    char timeString[26];
+
+    ctime_r(&file->modified, timeString);
+    timeString[strlen(timeString) - 1] = '\0';
+    fprintf(match->out, "\t%d:\t%-32s%-32s\n", ++match->index, timeString, file->path);
+    return 0;
+}
+
+/* Answers a live query line ("s <name>" or "c") from the table as it is so far */
+void answerLive (TrackerReader *reader, const char *line) {
+    long files, groups;
+
+    flockfile(stdout);
+    if (line[0] == PRGM_SRH && line[1] == ' ') {
+        LiveMatch match = {stdout, 0};
+        if ((files = trackerReaderQuery(reader, line + 2, printLiveMatch, &match)) < 0) {
+            fprintf(stderr, "Error: Couldn't copy the files named %s!\n", line + 2);
+        } else {
+            fprintf(stdout, "Live: %ld files named %s so far\n", files, line + 2);
+        }
+    } else if (line[0] == LIVE_COUNT) {
+        trackerReaderCounts(reader, &files, &groups);
+        fprintf(stdout, "Live: %ld files, %ld distinct names so far\n", files, groups);
+    } else if (line[0] != '\0') {
+        fprintf(stdout, "Live: Use 's <name>' to search or 'c' for counts\n");
+    }
+    funlockfile(stdout);
+}
+
+/* Live query thread: answers lines from standard input until the scan is over.
+ * Input is read unbuffered, so what follows is left for the menu */
+void *liveQueries (void *unused) {
+    TrackerReader *reader = trackerReaderCreate(tracker);
+    char line[NAME_MAX + 3];
+    size_t length = 0;
+
+    if (reader == NULL) {
+        fprintf(stderr, "Error: Couldn't start live queries!\n");
+        return unused;
+    }
+    while (atomic_load(&scanning)) {
+        struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+        char c;
+
+        if (poll(&input, 1, LIVE_POLL) <= 0) {
+            continue;
+        }
+        if (read(STDIN_FILENO, &c, 1) != 1) {
+            break;
+        }
+        if (c != '\n') {
+            if (length < sizeof(line) - 1) {
+                line[length++] = c;
+            }
+            continue;
+        }
+        line[length] = '\0';
+        length = 0;
+        answerLive(reader, line);
+    }
+    trackerReaderDestroy(reader);
+    return unused;
+}
+
+/* Applies a "--" command line option. Signals error with nonzero value */
+int parseOption (const char *arg) {
+    if (strcmp(arg, "--stats") == 0) {
+        statsEnabled = 1;
+    } else if (strncmp(arg, "--stats=", 8) == 0) {
+        statsEnabled = 1;
+        statsPath = arg + 8;
+    } else if (strcmp(arg, "--progress") == 0) {
+        showProgress = 1;
+    } else if (strcmp(arg, "--no-progress") == 0) {
+        showProgress = 0;
+    } else if (strcmp(arg, "--verbose") == 0) {
+        verbose = 1;
+    } else if (strcmp(arg, "--memory") == 0) {
+        memoryReport = 1;
+    } else if (strcmp(arg, "--diagnostics") == 0) {
+        diagnostics = 1;
+    } else if (strncmp(arg, "--save-index=", 13) == 0) {
+        saveIndexPath = arg + 13;
+    } else if (strncmp(arg, "--load-index=", 13) == 0) {
+        loadIndexPath = arg + 13;
+    } else if (strncmp(arg, "--min-count=", 12) == 0) {
+        reportFilter.minCount = atol(arg + 12);
+    } else if (strncmp(arg, "--min-size=", 11) == 0) {
+        reportFilter.minSize = strtoull(arg + 11, NULL, 10);
+    } else if (strncmp(arg, "--report-threads=", 17) == 0) {
+        reportThreads = atoi(arg + 17);
+    } else if (strncmp(arg, "--sort=", 7) == 0) {
+        int order = ORDER_NEWEST;
+        while (order >= 0 && strcmp(arg + 7, orderNames[order]) != 0) {
+            order--;
+        }
+        if (order < 0) {
+            return 1;
+        }
+        reportOrder = order;
+    } else if (strncmp(arg, "--checkpoint=", 13) == 0) {
+        checkpointPath = arg + 13;
+    } else if (strncmp(arg, "--checkpoint-interval=", 22) == 0) {
+        checkpointInterval = atol(arg + 22);
+    } else if (strcmp(arg, "--resume") == 0) {
+        resume = 1;
+    } else if (strncmp(arg, "--max-stats=", 12) == 0) {
+        limiterSetRate(LIMIT_STATS, atof(arg + 12));
+    } else if (strncmp(arg, "--max-dirs=", 11) == 0) {
+        limiterSetRate(LIMIT_DIRS, atof(arg + 11));
+    } else if (strncmp(arg, "--max-bytes=", 12) == 0) {
+        limiterSetRate(LIMIT_BYTES, atof(arg + 12));
+    } else if (strncmp(arg, "--max-latency=", 14) == 0) {
+        limiterSetLatencyTarget(atof(arg + 14));
+    } else if (strncmp(arg, "--limit-file=", 13) == 0) {
+        limitPath = arg + 13;
+    } else if (strcmp(arg, "--idle-io") == 0) {
+        idleIO = 1;
+    } else if (strcmp(arg, "--sample") == 0) {
+        sampling = 1;
+    } else if (strncmp(arg, "--sample-seconds=", 17) == 0) {
+        sampleBudget.seconds = atof(arg + 17);
+    } else if (strncmp(arg, "--sample-files=", 15) == 0) {
+        sampleBudget.files = atol(arg + 15);
+    } else if (strncmp(arg, "--sample-probes=", 16) == 0) {
+        sampleBudget.probes = atol(arg + 16);
+    } else if (strncmp(arg, "--sample-seed=", 14) == 0) {
+        sampleBudget.seed = atol(arg + 14);
+    } else if (strncmp(arg, "--shard=", 8) == 0) {
+        if (sscanf(arg + 8, "%ld/%ld", &shardIndex, &shardCount) != 2 ||
+            shardCount < 1 || shardIndex < 0 || shardIndex >= shardCount) {
+            return 1;
+        }
+    } else if (strncmp(arg, "--merge=", 8) == 0) {
+        mergePath = arg + 8;
+    } else if (strcmp(arg, "--diff") == 0) {
+        diffing = 1;
+    } else if (strncmp(arg, "--pipeline=", 11) == 0) {
+        if (sscanf(arg + 11, "%d,%d,%d", &stageThreads[STAGE_ENUMERATE],
+                   &stageThreads[STAGE_METADATA], &stageThreads[STAGE_KEY]) != 3 ||
+            stageThreads[STAGE_ENUMERATE] < 1 || stageThreads[STAGE_METADATA] < 1 ||
+            stageThreads[STAGE_KEY] < 1) {
+            return 1;
+        }
+    } else if (strcmp(arg, "--live") == 0) {
+        live = 1;
+    } else if (strncmp(arg, "--serve=", 8) == 0) {
+        servePath = arg + 8;
+    } else if (strncmp(arg, "--stream=", 9) == 0) {
+        streamPath = arg + 9;
+    } else if (strncmp(arg, "--estimate=", 11) == 0) {
+        if ((estimateFiles = atol(arg + 11)) <= 0) {
+            return 1;
+        }
+    } else {
+        return 1;
+    }
+    return 0;
 }
 
 /* Main: Scans current directory if no arguments given. Else scans arguments */
 int main (int argc, const char *argv[]) {
-    char option, fileName[NAME_MAX];
+    char option = '\0', fileName[NAME_MAX];
+    int directories = 0, resumed = 0;
+    pthread_t liveThread;
+    long long start;
 
-    // Ensure that at least one directory has been specified.
-    if (argc == 1) {
+    // Apply options, they may be given anywhere on the command line.
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            directories++;
+        } else if (parseOption(argv[i])) {
+            fprintf(stderr, "Error: Unknown option %s!\n", argv[i]);
+            return -1;
+        }
+    }
+
+    // Ensure that at least one directory (or an index, or a scan to resume) is given.
+    if (resume && checkpointPath == NULL) {
+        fprintf(stderr, "Error: --resume needs --checkpoint=<file>!\n");
+        return -1;
+    }
+    // Merging only combines index files (given in place of directories).
+    if (mergePath != NULL) {
+        const char **inputs = malloc((directories + 1) * sizeof(char *));
+        int n = 0;
+
+        for (int i = 1; inputs != NULL && i < argc; i++) {
+            if (strncmp(argv[i], "--", 2) != 0) {
+                inputs[n++] = argv[i];
+            }
+        }
+        if (n == 0 || trackerMergeIndexes(mergePath, inputs, n)) {
+            fprintf(stderr, "Error: Couldn't merge into index %s!\n", mergePath);
+            free(inputs);
+            return -1;
+        }
+        fprintf(stdout, "%s: Merged %d indexes into %s\n", PRGM_NAME, n, mergePath);
+        free(inputs);
+        return 0;
+    }
+
+    // Diffing compares two index files (given in place of directories).
+    if (diffing) {
+        const char *paths[2];
+        int n = 0;
+
+        for (int i = 1; i < argc; i++) {
+            if (strncmp(argv[i], "--", 2) != 0 && n < 2) {
+                paths[n++] = argv[i];
+            }
+        }
+        if (directories != 2) {
+            fprintf(stderr, "Error: --diff needs two index files (before, after)!\n");
+            return -1;
+        }
+        if (trackerDiffIndexes(paths[0], paths[1], stdout)) {
+            fprintf(stderr, "Error: Couldn't compare %s and %s!\n", paths[0], paths[1]);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (stageThreads[STAGE_ENUMERATE] > 0 && checkpointPath != NULL) {
+        fprintf(stderr, "Error: --pipeline can't be combined with --checkpoint!\n");
+        return -1;
+    }
+    if (sampling && (checkpointPath != NULL || directories == 0)) {
+        fprintf(stderr, "Error: --sample needs directories and no --checkpoint!\n");
+        return -1;
+    }
+    if (directories == 0 && loadIndexPath == NULL && !resume) {
         fprintf(stdout, "%s: %s", PRGM_NAME, PRGM_USE);
         return -1;
     }
+    start = statsNanos();
+
+    // Open the duplicate stream, it is written while scanning.
+    if (streamPath != NULL) {
+        streamOut = strcmp(streamPath, "-") == 0 ? stdout : fopen(streamPath, "w");
+        if (streamOut == NULL) {
+            fprintf(stderr, "Error: Can't open stream %s!\n", streamPath);
+            return -1;
+        }
+    }
 
     // Attempt to allocate the file table.
-    if (initializeFileTable()) {
+    if ((tracker = trackerCreate(&(TrackerConfig){
+            .reportThreads = reportThreads,
+            .stream = streamOut != NULL ? streamDuplicate : NULL,
+            .streamContext = streamOut})) == NULL) {
         fprintf(stderr, "Error: Couldn't start up the file table!\n");
         return -1;
     }
 
-    // Scan all given directories.
-    while (--argc > 0) {
-        fprintf(stdout, "%s: Scanning top-level directory %s\n", PRGM_NAME, *(argv + 1));
-        scanFile (*++argv);
+    // Load a saved index.
+    if (loadIndexPath != NULL && trackerLoad(tracker, loadIndexPath)) {
+        fprintf(stderr, "Error: Couldn't load index %s!\n", loadIndexPath);
+        return -1;
+    }
+
+    // Open the checkpoint journal, picking up where a previous run stopped.
+    if (checkpointPath != NULL) {
+        if (checkpointOpen(checkpointPath, resume, checkpointInterval, tracker,
+                           pushDirectory, &resumed)) {
+            fprintf(stderr, "Error: Couldn't open checkpoint %s!\n", checkpointPath);
+            return -1;
+        }
+        if (resumed) {
+            fprintf(stdout, "%s: Resuming (%ld files, %ld directories pending)\n",
+                    PRGM_NAME, trackerFileCount(tracker), pendingCount);
+        } else if (resume) {
+            fprintf(stdout, "%s: No checkpoint to resume, starting over\n", PRGM_NAME);
+        }
+    }
+
+    // Lower the scan's impact on the host.
+    if (idleIO && limiterIdlePriority()) {
+        fprintf(stderr, "Error: Couldn't enter the idle I/O class! -Ignoring-\n");
+    }
+    if (limitPath != NULL && limiterWatch(limitPath)) {
+        fprintf(stderr, "Error: Can't read control file %s!\n", limitPath);
+        return -1;
+    }
+
+    // Start the progress reporter.
+    if (showProgress == -1) {
+        showProgress = isatty(STDERR_FILENO);
+    }
+    if (showProgress && startProgress()) {
+        fprintf(stderr, "Error: Couldn't start the progress reporter!\n");
+    }
+
+    // Answer queries against the table while it is being filled.
+    atomic_store(&scanning, 1);
+    if (live && pthread_create(&liveThread, NULL, liveQueries, NULL) != 0) {
+        fprintf(stderr, "Error: Couldn't start live queries!\n");
+        live = 0;
+    }
+
+    // Sample the given directories, or queue them all (a resumed scan has its own) and scan.
+    if (sampling) {
+        SampleEstimate estimate;
+        const char **roots = malloc(directories * sizeof(char *));
+
+        for (int i = 1, n = 0; roots != NULL && i < argc; i++) {
+            if (strncmp(argv[i], "--", 2) != 0) {
+                roots[n++] = argv[i];
+            }
+        }
+        if (roots == NULL || sampleScan(tracker, roots, directories, &sampleBudget, &estimate)) {
+            fprintf(stderr, "Error: Couldn't sample the given directories!\n");
+            return -1;
+        }
+        stopProgress();
+        printSampleEstimate(stdout, &estimate);
+        free(roots);
+        argc = 0;
+    }
+    while (!resumed && --argc > 0) {
+        if (strncmp(*++argv, "--", 2) == 0) {
+            continue;
+        }
+        fprintf(stdout, "%s: Scanning top-level directory %s\n", PRGM_NAME, *argv);
+        if (shardCount > 0) {
+            scanShard(*argv);
+        } else {
+            scanFile (*argv);
+        }
+    }
+    if (stageThreads[STAGE_ENUMERATE] == 0) {
+        scanPending();
+    } else if (scanPipelined()) {
+        fprintf(stderr, "Error: Couldn't start the scan pipeline! -Scanning in one thread-\n");
+        scanPending();
+    }
+    stopProgress();
+    atomic_store(&scanning, 0);
+    if (live) {
+        pthread_join(liveThread, NULL);
+    }
+
+    // End the stream, so its readers see the scan finish.
+    if (streamOut != NULL && streamOut != stdout) {
+        fclose(streamOut);
+    } else {
+        flushStream();
+    }
+    streamOut = NULL;
+
+    // The final checkpoint has an empty frontier: resuming it rescans nothing.
+    if (checkpointCommit(NULL, 0)) {
+        fprintf(stderr, "Error: Couldn't write checkpoint!\n");
     }
+    checkpointClose();
 
     // Output results, prompt to search/dump contents/exit.
-    fprintf(stdout, "%s: Finished scanning (%ld files found).\n", PRGM_NAME, getFileCount());
-    do {
+    fprintf(stdout, "%s: Finished scanning (%ld files found).\n", PRGM_NAME, trackerFileCount(tracker));
+    if (saveIndexPath != NULL && trackerSave(tracker, saveIndexPath)) {
+        fprintf(stderr, "Error: Couldn't save index %s!\n", saveIndexPath);
+    }
+    if (diagnostics) {
+        trackerDiagnostics(tracker, stdout);
+    }
+    if (memoryReport) {
+        printMemoryReport(stdout, trackerFileCount(tracker));
+    }
+    if (estimateFiles) {
+        printMemoryEstimate(stdout, trackerFileCount(tracker), estimateFiles);
+        option = PRGM_EXT;
+    }
+
+    // Serve the table to other tools rather than the menu.
+    if (servePath != NULL && option != PRGM_EXT) {
+        ServerTotals served;
+
+        fprintf(stdout, "%s: Serving queries on %s\n", PRGM_NAME, servePath);
+        fflush(stdout);
+        if (serverRun(tracker, servePath, &served)) {
+            fprintf(stderr, "Error: Couldn't serve queries on %s!\n", servePath);
+        } else {
+            fprintf(stdout, "%s: Served %ld requests to %ld clients\n", PRGM_NAME,
+                    served.requests, served.clients);
+        }
+        option = PRGM_EXT;
+    }
+    while (option != PRGM_EXT) {
         fprintf(stdout, "%s:", PRGM_OPT);
-        scanf("\n%c", &option);
+        if (scanf("\n%c", &option) != 1) {
+            option = PRGM_EXT;
+        }
 
         if (option == PRGM_ALL) {
-            printFileTable();
+            if (trackerPrintSorted(tracker, &reportFilter, reportOrder, stdout)) {
+                fprintf(stderr, "Error: Couldn't sort the report!\n");
+            }
         }
 
         if (option == PRGM_SRH) {
             fprintf(stdout, "\nName: ");
             scanf("%255s", fileName);
             fprintf(stdout, "\nSearching for %s\n", fileName);
-            findFile(fileName);
+            trackerPrintMatches(tracker, fileName, stdout);
         }
-    } while (option != PRGM_EXT);
+    }
 
+    // Report statistics.
+    if (statsEnabled) {
+        double wallSeconds = (statsNanos() - start) / 1e9;
 
-    // Clean up.
-    if (freeFileTable()) {
-        fprintf(stderr, "Error: Problem free'ing the file table!\n");
+        mergeThreadStatistics();
+        if (statsPath == NULL) {
+            printStatistics(stderr, wallSeconds);
+        } else if (exportStatistics(statsPath, wallSeconds)) {
+            fprintf(stderr, "Error: Couldn't write statistics to %s!\n", statsPath);
+        }
     }
 
+    // Clean up.
+    free(pendingDirectories);
+    trackerDestroy(tracker);
+
     return 0;
 }
@@ -0,0 +1,624 @@
+/*
+********************************************************************************
+*
+* Filename     : duplicateServer.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Answers tracker queries over a Unix domain socket.
+********************************************************************************
+*/
+
+#define _GNU_SOURCE
+#include "duplicateServer.h"
+#include "duplicateMemory.h"
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/*
+ * One thread serves every client. Each client has an input buffer, parsed for
+ * as many whole requests as it holds, and an output buffer the responses are
+ * appended to. The output is written once per read, so a client pipelining
+ * requests gets many responses per system call. Events are level-triggered: a
+ * client is watched for input until its unsent output reaches
+ * SERVER_MAX_OUTPUT, and for output while any is unsent.
+ */
+
+/* Bytes read at a time, events taken per wait, and the listen backlog */
+#define SERVER_READ     (64 * 1024)
+#define SERVER_EVENTS   64
+#define SERVER_BACKLOG  128
+
+/* A connected client */
+typedef struct client {
+    int fd;
+    char *input;
+    size_t inputUsed, inputCapacity;
+    char *output;
+    size_t outputStart, outputUsed, outputCapacity;
+    uint32_t events;            // What the client is watched for.
+    int ended;                  // No more input.
+    int closing;                // Answer nothing more (an oversized request).
+    struct client *next, *previous;
+} Client;
+
+/* A response being built */
+typedef struct {
+    Client *client;
+    size_t header;              // Offset of its header in the output.
+    size_t result;              // Offset of the current result's entry count.
+    uint32_t entries;           // Entries in the current result.
+    long total;                 // Entries in the whole response.
+    int status;
+    int failed;                 // Out of memory.
+} Response;
+
+/* Keys in byte order, for prefix queries */
+static const char **keys;
+static long keyCount;
+static size_t keyBytes;
+
+/* Connected clients, and the listening socket while out of descriptors for more */
+static Client *clients;
+static int pausedListener = -1;
+
+/* Pipe a stop signal is passed through to the event loop */
+static int stopPipe[2] = {-1, -1};
+
+/*
+ ******************************************************************************
+ *                             Auxillary Functions
+ ******************************************************************************
+ */
+
+/* Grows a buffer to hold 'needed' bytes. Signals error with nonzero value */
+static int reserve (char **buffer, size_t *capacity, size_t needed) {
+    size_t size = *capacity ? *capacity : SERVER_READ;
+    char *grown;
+
+    if (needed <= *capacity) {
+        return 0;
+    }
+    while (size < needed) {
+        size *= 2;
+    }
+    if ((grown = realloc(*buffer, size)) == NULL) {
+        return 1;
+    }
+    *buffer = grown;
+    *capacity = size;
+    return 0;
+}
+
+/* Appends 'size' bytes to the client's output. Signals error with nonzero value */
+static int append (Client *c, const void *data, size_t size) {
+    if (reserve(&c->output, &c->outputCapacity, c->outputUsed + size)) {
+        return 1;
+    }
+    memcpy(c->output + c->outputUsed, data, size);
+    c->outputUsed += size;
+    return 0;
+}
+
+/* SIGINT and SIGTERM handler: wakes the event loop to stop it */
+static void requestStop (int signal) {
+    int saved = errno;
+
+    (void)signal;
+    if (write(stopPipe[1], "", 1) == -1) {
+        // The pipe is full, so a stop is already pending.
+    }
+    errno = saved;
+}
+
+/* Orders keys byte-wise */
+static int compareKeys (const void *a, const void *b) {
+    return strcmp(*(const char * const *)a, *(const char * const *)b);
+}
+
+/* Collects and sorts the tracker's keys. Signals error with nonzero value */
+static int indexKeys (Tracker *t) {
+    TrackerIterator *it = malloc(sizeof(TrackerIterator));
+    GroupView group;
+
+    keyCount = 0;
+    keyBytes = (trackerGroupCount(t) + 1) * sizeof(char *);
+    if (it == NULL || (keys = memAlloc(MEM_CACHES, keyBytes, keyBytes)) == NULL) {
+        free(it);
+        return 1;
+    }
+    trackerBegin(t, NULL, it);
+    while (trackerNextGroup(it, &group)) {
+        keys[keyCount++] = group.key;
+    }
+    free(it);
+    qsort(keys, keyCount, sizeof(char *), compareKeys);
+    return 0;
+}
+
+/* Returns the first key not ordered before 'prefix' */
+static long firstKey (const char *prefix) {
+    long lo = 0, hi = keyCount;
+
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (strcmp(keys[mid], prefix) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ ******************************************************************************
+ *                                 Responses
+ ******************************************************************************
+ */
+
+/* Starts a response to 'request' */
+static void beginResponse (Response *r, Client *c, const ServerHeader *request) {
+    ServerHeader header = {0, request->id, request->kind, SERVER_OK, 0};
+
+    *r = (Response){c, c->outputUsed, 0, 0, 0, SERVER_OK, 0};
+    r->failed = append(c, &header, sizeof(header));
+}
+
+/* Starts a result of the response */
+static void beginResult (Response *r) {
+    uint32_t none = 0;
+
+    r->result = r->client->outputUsed;
+    r->entries = 0;
+    r->failed |= append(r->client, &none, sizeof(none));
+}
+
+/* Visitor adding a file to the current result. Stops at SERVER_MAX_FILES */
+static int addEntry (void *context, const FileView *file) {
+    Response *r = context;
+    Client *c = r->client;
+    uint16_t length = strlen(file->path);      // Under MAX_PATH.
+    int64_t modified = file->modified;
+
+    if (r->total == SERVER_MAX_FILES) {
+        r->status = SERVER_TRUNCATED;
+        return 1;
+    }
+    if (r->failed || reserve(&c->output, &c->outputCapacity,
+                             c->outputUsed + SERVER_ENTRY + length)) {
+        r->failed = 1;
+        return 1;
+    }
+    memcpy(c->output + c->outputUsed, &file->size, 8);
+    memcpy(c->output + c->outputUsed + 8, &modified, 8);
+    memcpy(c->output + c->outputUsed + 16, &length, 2);
+    memcpy(c->output + c->outputUsed + SERVER_ENTRY, file->path, length);
+    c->outputUsed += SERVER_ENTRY + length;
+    r->entries++;
+    r->total++;
+    return 0;
+}
+
+/* Ends the current result */
+static void endResult (Response *r) {
+    if (!r->failed) {
+        memcpy(r->client->output + r->result, &r->entries, sizeof(r->entries));
+    }
+}
+
+/* Ends the response. Signals error (out of memory) with nonzero value */
+static int endResponse (Response *r) {
+    ServerHeader header;
+    char *at;
+
+    if (r->failed) {
+        return 1;
+    }
+
+    // Entries aren't aligned, so neither is the header.
+    at = r->client->output + r->header;
+    memcpy(&header, at, sizeof(header));
+    header.length = r->client->outputUsed - r->header - sizeof(ServerHeader);
+    header.status = r->status;
+    memcpy(at, &header, sizeof(header));
+    return 0;
+}
+
+/* Adds the files named 'name' (of 'length' bytes) as a result */
+static void findName (Tracker *t, Response *r, const char *name, size_t length) {
+    char fileName[NAME_MAX + 1];
+
+    beginResult(r);
+    if (length > 0 && length <= NAME_MAX && memchr(name, '\0', length) == NULL) {
+        memcpy(fileName, name, length);
+        fileName[length] = '\0';
+        r->failed |= trackerQuery(t, fileName, addEntry, r) < 0;
+    }
+    endResult(r);
+}
+
+/* Adds the files of every name starting with 'prefix' as a result */
+static void findPrefix (Tracker *t, Response *r, const char *prefix, size_t length) {
+    char name[NAME_MAX + 1], buffer[NAME_MAX + 1];
+    const char *start;
+
+    // Keys are stored normalised, so the prefix is too.
+    beginResult(r);
+    if (length <= NAME_MAX && memchr(prefix, '\0', length) == NULL) {
+        memcpy(name, prefix, length);
+        name[length] = '\0';
+        start = trackerKey(t, name, buffer);
+        for (long i = firstKey(start); i < keyCount && strncmp(keys[i], start, length) == 0 &&
+                                       r->status == SERVER_OK && !r->failed; i++) {
+            r->failed |= trackerQuery(t, keys[i], addEntry, r) < 0;
+        }
+    }
+    endResult(r);
+}
+
+/* Appends the response to one request. Signals error with nonzero value */
+static int answer (Tracker *t, Client *c, const ServerHeader *request, const char *payload) {
+    uint64_t counts[2];
+    Response r;
+
+    beginResponse(&r, c, request);
+    switch (request->kind) {
+        case SERVER_FIND:
+            findName(t, &r, payload, request->length);
+            break;
+        case SERVER_PREFIX:
+            findPrefix(t, &r, payload, request->length);
+            break;
+        case SERVER_BATCH:
+            if (request->length > 0 && payload[request->length - 1] != '\0') {
+                r.status = SERVER_BAD_REQUEST;
+                break;
+            }
+            for (size_t at = 0; at < request->length && !r.failed; ) {
+                size_t length = strlen(payload + at);
+                findName(t, &r, payload + at, length);
+                at += length + 1;
+            }
+            break;
+        case SERVER_COUNTS:
+            counts[0] = trackerFileCount(t);
+            counts[1] = trackerGroupCount(t);
+            r.failed |= append(c, counts, sizeof(counts));
+            break;
+        default:
+            r.status = SERVER_BAD_REQUEST;
+    }
+
+    // A bad request's response has no payload.
+    if (r.status == SERVER_BAD_REQUEST) {
+        c->outputUsed = r.header + sizeof(ServerHeader);
+    }
+    return endResponse(&r);
+}
+
+/*
+ ******************************************************************************
+ *                                  Clients
+ ******************************************************************************
+ */
+
+/* Frees a client, closing its connection */
+static void dropClient (int poller, Client *c) {
+    if (c->previous != NULL) {
+        c->previous->next = c->next;
+    } else {
+        clients = c->next;
+    }
+    if (c->next != NULL) {
+        c->next->previous = c->previous;
+    }
+    epoll_ctl(poller, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->input);
+    free(c->output);
+    free(c);
+
+    // A descriptor is free again, so accept clients again.
+    if (pausedListener != -1) {
+        epoll_ctl(poller, EPOLL_CTL_MOD, pausedListener,
+                  &(struct epoll_event){EPOLLIN, {.ptr = NULL}});
+        pausedListener = -1;
+    }
+}
+
+/* Answers the whole requests in the client's input until SERVER_MAX_OUTPUT
+ * bytes are unsent. Returns the number answered, or -1 on error */
+static long answerInput (Tracker *t, Client *c) {
+    size_t at = 0;
+    long answered = 0;
+
+    while (!c->closing && c->outputUsed - c->outputStart < SERVER_MAX_OUTPUT &&
+           c->inputUsed - at >= sizeof(ServerHeader)) {
+        ServerHeader request;
+
+        memcpy(&request, c->input + at, sizeof(request));
+        if (request.length > SERVER_MAX_REQUEST) {
+            request.status = SERVER_TOO_LARGE;
+            request.length = 0;
+            if (append(c, &request, sizeof(request))) {
+                return -1;
+            }
+            c->closing = 1;
+            break;
+        }
+        if (c->inputUsed - at < sizeof(ServerHeader) + request.length) {
+            break;
+        }
+        if (answer(t, c, &request, c->input + at + sizeof(ServerHeader))) {
+            return -1;
+        }
+        at += sizeof(ServerHeader) + request.length;
+        answered++;
+    }
+
+    // Keep the partial request at the start of the buffer.
+    memmove(c->input, c->input + at, c->inputUsed - at);
+    c->inputUsed -= at;
+    return answered;
+}
+
+/* Reads what the client sent. Returns 1 at end of input, -1 on error */
+static int readInput (Client *c) {
+    for (;;) {
+        ssize_t n;
+
+        if (reserve(&c->input, &c->inputCapacity, c->inputUsed + SERVER_READ)) {
+            return -1;
+        }
+        n = read(c->fd, c->input + c->inputUsed, c->inputCapacity - c->inputUsed);
+        if (n > 0) {
+            c->inputUsed += n;
+
+            // Let the requests read so far be answered before reading more.
+            if (c->inputUsed >= sizeof(ServerHeader) + SERVER_MAX_REQUEST) {
+                return 0;
+            }
+        } else if (n == 0) {
+            return 1;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+/* Sends as much output as the socket takes. Signals error with nonzero value */
+static int writeOutput (Client *c) {
+    while (c->outputStart < c->outputUsed) {
+        ssize_t n = send(c->fd, c->output + c->outputStart, c->outputUsed - c->outputStart,
+                         MSG_NOSIGNAL);
+        if (n > 0) {
+            c->outputStart += n;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else if (errno != EINTR) {
+            return 1;
+        }
+    }
+    if (c->outputStart == c->outputUsed) {
+        c->outputStart = c->outputUsed = 0;
+    }
+    return 0;
+}
+
+/* Watches the client for what it needs next. Signals error with nonzero value */
+static int watchClient (int poller, Client *c) {
+    size_t unsent = c->outputUsed - c->outputStart;
+    uint32_t events = (unsent > 0 ? EPOLLOUT : 0) |
+                      (!c->ended && !c->closing && unsent < SERVER_MAX_OUTPUT ? EPOLLIN : 0);
+    struct epoll_event event = {events, {.ptr = c}};
+
+    if (events == c->events) {
+        return 0;
+    }
+    c->events = events;
+    return epoll_ctl(poller, EPOLL_CTL_MOD, c->fd, &event) == -1;
+}
+
+/* Serves a client's event, dropping the client once it is done or failed.
+ * Returns the requests answered */
+static long serveClient (Tracker *t, int poller, Client *c, uint32_t events) {
+    long answered = 0, more;
+    int ended = 0;
+
+    if ((events & EPOLLERR) || ((events & EPOLLIN) && (ended = readInput(c)) < 0)) {
+        dropClient(poller, c);
+        return 0;
+    }
+    c->ended |= ended;
+
+    // Requests held back while the output was full are answered as it drains.
+    do {
+        if ((more = answerInput(t, c)) < 0 || writeOutput(c)) {
+            dropClient(poller, c);
+            return answered;
+        }
+        answered += more;
+    } while (more > 0 && c->outputUsed == 0);
+
+    if (((c->ended || c->closing) && c->outputUsed == 0) || watchClient(poller, c)) {
+        dropClient(poller, c);
+    }
+    return answered;
+}
+
+/* Accepts waiting connections. Returns the number accepted */
+static long acceptClients (int poller, int listener) {
+    long accepted = 0;
+    int fd;
+
+    while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+        Client *c = calloc(1, sizeof(Client));
+        struct epoll_event event = {EPOLLIN, {.ptr = c}};
+
+        if (c == NULL || epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event) == -1) {
+            fprintf(stderr, "Error: Couldn't take a client!\n");
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->events = EPOLLIN;
+        c->next = clients;
+        if (clients != NULL) {
+            clients->previous = c;
+        }
+        clients = c;
+        accepted++;
+    }
+    // Out of descriptors, stop watching for clients until one leaves.
+    if (errno == EMFILE || errno == ENFILE) {
+        fprintf(stderr, "Error: Can't accept clients (%s)! -Waiting for one to leave-\n",
+                strerror(errno));
+        epoll_ctl(poller, EPOLL_CTL_MOD, listener, &(struct epoll_event){0, {.ptr = NULL}});
+        pausedListener = listener;
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+               errno != ECONNABORTED) {
+        fprintf(stderr, "Error: Can't accept clients (%s)!\n", strerror(errno));
+    }
+    return accepted;
+}
+
+/* Binds a listening socket at 'path', replacing a stale one. Returns it, or -1
+ * with errno set */
+static int listenAt (const char *path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    socklen_t size = sizeof(address);
+    int fd, bound, error;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+        return -1;
+    }
+    bound = bind(fd, (struct sockaddr *)&address, size) == 0;
+    if (!bound && errno == EADDRINUSE) {
+        struct stat info;
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        // A socket nobody answers on is left over from a server that died.
+        if (probe != -1 && connect(probe, (struct sockaddr *)&address, size) == -1 &&
+            errno == ECONNREFUSED && stat(path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+            unlink(path);
+        }
+        if (probe != -1) {
+            close(probe);
+        }
+        bound = bind(fd, (struct sockaddr *)&address, size) == 0;
+    }
+    if (!bound || listen(fd, SERVER_BACKLOG) == -1) {
+        error = errno;
+        if (bound) {
+            unlink(path);
+        }
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ ******************************************************************************
+ *                             Public Functions
+ ******************************************************************************
+ */
+
+/* Answers queries on 't' at 'socketPath' until SIGINT or SIGTERM */
+int serverRun (Tracker *t, const char *socketPath, ServerTotals *totals) {
+    struct epoll_event events[SERVER_EVENTS], event;
+    int listener = -1, poller = -1, failed = 0, running = 1, handled;
+    struct sigaction stop, previous[2];
+
+    *totals = (ServerTotals){0, 0};
+    if (indexKeys(t)) {
+        fprintf(stderr, "Error: Couldn't index the names!\n");
+        return 1;
+    }
+    if (pipe2(stopPipe, O_CLOEXEC | O_NONBLOCK) == -1 || (listener = listenAt(socketPath)) == -1) {
+        fprintf(stderr, "Error: Can't listen on %s (%s)!\n", socketPath, strerror(errno));
+        failed = 1;
+    }
+
+    // Stop signals are taken as events (whichever thread gets them), so a
+    // request is never cut short.
+    memset(&stop, 0, sizeof(stop));
+    stop.sa_handler = requestStop;
+    stop.sa_flags = SA_RESTART;
+    sigemptyset(&stop.sa_mask);
+    handled = !failed && sigaction(SIGINT, &stop, &previous[0]) == 0;
+    handled += handled && sigaction(SIGTERM, &stop, &previous[1]) == 0;
+    if (!failed && (handled < 2 || (poller = epoll_create1(EPOLL_CLOEXEC)) == -1 ||
+                    epoll_ctl(poller, EPOLL_CTL_ADD, listener,
+                              &(struct epoll_event){EPOLLIN, {.ptr = NULL}}) == -1 ||
+                    epoll_ctl(poller, EPOLL_CTL_ADD, stopPipe[0],
+                              &(struct epoll_event){EPOLLIN, {.ptr = stopPipe}}) == -1)) {
+        fprintf(stderr, "Error: Couldn't start the event loop!\n");
+        failed = 1;
+    }
+
+    while (running && !failed) {
+        int n = epoll_wait(poller, events, SERVER_EVENTS, -1);
+
+        if (n == -1 && errno != EINTR) {
+            failed = 1;
+        }
+        for (int i = 0; i < n && running; i++) {
+            event = events[i];
+            if (event.data.ptr == NULL) {
+                totals->clients += acceptClients(poller, listener);
+            } else if (event.data.ptr == stopPipe) {
+                running = 0;
+            } else {
+                totals->requests += serveClient(t, poller, event.data.ptr, event.events);
+            }
+        }
+    }
+
+    // Disconnect the clients still connected, then put the signals back.
+    while (clients != NULL) {
+        dropClient(poller, clients);
+    }
+    if (poller != -1) {
+        close(poller);
+    }
+    if (listener != -1) {
+        close(listener);
+        unlink(socketPath);
+    }
+    if (handled > 1) {
+        sigaction(SIGTERM, &previous[1], NULL);
+    }
+    if (handled > 0) {
+        sigaction(SIGINT, &previous[0], NULL);
+    }
+    for (int i = 0; i < 2 && stopPipe[i] != -1; i++) {
+        close(stopPipe[i]);
+        stopPipe[i] = -1;
+    }
+    pausedListener = -1;
+    memFree(MEM_CACHES, keys, keyBytes, keyBytes);
+    keys = NULL;
+    return failed;
+}
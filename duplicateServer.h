@@ -0,0 +1,100 @@
+/*
+********************************************************************************
+*
+* Filename     : duplicateServer.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Answers tracker queries over a Unix domain socket.
+********************************************************************************
+*/
+
+#include "duplicateTracker.h"
+
+#if !defined(duplicateServer_h)
+#define duplicateServer_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/*
+ * Protocol. Every request and response is a ServerHeader followed by 'length'
+ * payload bytes. Integers are in host byte order (the socket is local). A
+ * client may send any number of requests without waiting. Responses come back
+ * in request order and echo the request's id.
+ *
+ * Request payloads:
+ *  SERVER_FIND    a file name (not terminated)
+ *  SERVER_PREFIX  a name prefix: the files of every name starting with it
+ *  SERVER_BATCH   file names, each followed by a '\0'
+ *  SERVER_COUNTS  nothing
+ *
+ * Response payloads (SERVER_OK or SERVER_TRUNCATED):
+ *  FIND, PREFIX   one result
+ *  BATCH          one result per name, in request order
+ *  COUNTS         uint64 files, uint64 names
+ * A result is a uint32 entry count followed by that many entries, each a
+ * uint64 size, int64 mtime, uint16 path length and the path (not terminated),
+ * packed without padding. FIND and BATCH entries are newest first per name,
+ * and PREFIX lists names in byte order.
+ */
+
+/* Request kinds */
+enum {
+    SERVER_FIND = 1,
+    SERVER_PREFIX,
+    SERVER_BATCH,
+    SERVER_COUNTS
+};
+
+/* Response statuses */
+enum {
+    SERVER_OK,
+    SERVER_TRUNCATED,           // SERVER_MAX_FILES entries, the rest left out.
+    SERVER_BAD_REQUEST,         // Unknown kind or malformed payload (no payload).
+    SERVER_TOO_LARGE            // Payload over SERVER_MAX_REQUEST, connection closed.
+};
+
+/* Frame header, both ways */
+typedef struct {
+    uint32_t length;            // Payload bytes that follow.
+    uint32_t id;                // The client's, echoed in the response.
+    uint8_t kind;
+    uint8_t status;             // Responses only.
+    uint16_t reserved;
+} ServerHeader;
+
+/* Bytes of an entry before its path */
+#define SERVER_ENTRY    18
+
+/* Largest request payload */
+#define SERVER_MAX_REQUEST  (64 * 1024)
+
+/* Most entries in one response */
+#define SERVER_MAX_FILES    4096
+
+/* Unsent response bytes at which a client's requests are no longer read */
+#define SERVER_MAX_OUTPUT   (1024 * 1024)
+
+/* What a server did */
+typedef struct {
+    long clients, requests;
+} ServerTotals;
+
+/*
+ ******************************************************************************
+ *                                  Prototypes
+ ******************************************************************************
+ */
+
+ /*
+  * Answers queries on 't' at Unix socket 'socketPath' until SIGINT or SIGTERM,
+  * from one thread running an epoll loop over every client. 't' must not change
+  * meanwhile. A stale socket file is replaced, a live one is an error. Removes
+  * the socket on return. Signals error with nonzero value.
+  */
+ int serverRun (Tracker *t, const char *socketPath, ServerTotals *totals);
+
+#endif
@@ -0,0 +1,145 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateStatistics.c
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Per-thread scan counters and per-phase monotonic timers.
+********************************************************************************
+*/
+
+#include "duplicateStatistics.h"
+#include <pthread.h>
+#include <string.h>
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Counter names, in StatCounter order */
+static const char *counterNames[STAT_COUNTERS] = {
+    "dirs_opened", "entries_read", "stats_issued", "stat_errors",
+    "files_tracked", "bytes_stored", "table_probes", "output_bytes"
+};
+
+/* Phase names, in StatPhase order */
+static const char *phaseNames[PHASE_COUNT] = {
+    "opendir", "readdir", "stat", "hash", "insert", "report"
+};
+
+/* Stage names, in StatStage order */
+static const char *stageNames[STAGE_COUNT] = {
+    "enumerate", "metadata", "key", "insert"
+};
+
+/* Nonzero if statistics are being collected */
+int statsEnabled;
+
+/* The calling thread's statistics */
+_Thread_local Statistics threadStatistics;
+
+/* Merged totals of all threads */
+static Statistics totalStatistics;
+
+/* Guards totalStatistics */
+static pthread_mutex_t totalsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ ******************************************************************************
+ *                             Public Functions
+ ******************************************************************************
+ */
+
+/* Folds the calling thread's statistics into the totals and resets them */
+void mergeThreadStatistics (void) {
+    pthread_mutex_lock(&totalsLock);
+    for (int c = 0; c < STAT_COUNTERS; c++) {
+        totalStatistics.counters[c] += threadStatistics.counters[c];
+    }
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        totalStatistics.phaseCalls[p] += threadStatistics.phaseCalls[p];
+        totalStatistics.phaseNanos[p] += threadStatistics.phaseNanos[p];
+    }
+    for (int g = 0; g < STAGE_COUNT; g++) {
+        totalStatistics.stageThreads[g] += threadStatistics.stageThreads[g];
+        totalStatistics.stageBatches[g] += threadStatistics.stageBatches[g];
+        totalStatistics.stageBusyNanos[g] += threadStatistics.stageBusyNanos[g];
+        totalStatistics.stageWaitNanos[g] += threadStatistics.stageWaitNanos[g];
+        totalStatistics.stageQueued[g] += threadStatistics.stageQueued[g];
+    }
+    pthread_mutex_unlock(&totalsLock);
+
+    memset(&threadStatistics, 0, sizeof(Statistics));
+}
+
+/* Copies the merged totals into 'totals' */
+void getStatistics (Statistics *totals) {
+    pthread_mutex_lock(&totalsLock);
+    *totals = totalStatistics;
+    pthread_mutex_unlock(&totalsLock);
+}
+
+/* Prints the merged totals in human readable form */
+void printStatistics (FILE *out, double wallSeconds) {
+    Statistics s;
+
+    getStatistics(&s);
+    fprintf(out, "Statistics (%.3fs wall):\n", wallSeconds);
+    for (int c = 0; c < STAT_COUNTERS; c++) {
+        fprintf(out, "\t%-16s%ld\n", counterNames[c], s.counters[c]);
+    }
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        double seconds = s.phaseNanos[p] / 1e9;
+        fprintf(out, "\t%-16s%10.3fs  %10ld calls  %8.0f ns/call\n", phaseNames[p],
+                seconds, s.phaseCalls[p],
+                s.phaseCalls[p] ? (double)s.phaseNanos[p] / s.phaseCalls[p] : 0.0);
+    }
+
+    // A pipelined scan also shows how busy each stage was and how much queued for it.
+    for (int g = 0; g < STAGE_COUNT; g++) {
+        long long total = s.stageBusyNanos[g] + s.stageWaitNanos[g];
+        if (s.stageThreads[g] == 0) {
+            continue;
+        }
+        fprintf(out, "\tstage %-10s%3ld threads  %10ld batches  %5.1f%% busy  %6.1f queued\n",
+                stageNames[g], s.stageThreads[g], s.stageBatches[g],
+                total ? 100.0 * s.stageBusyNanos[g] / total : 0.0,
+                s.stageBatches[g] ? (double)s.stageQueued[g] / s.stageBatches[g] : 0.0);
+    }
+}
+
+/* Writes the merged totals as JSON to 'path'. Signals error with nonzero value */
+int exportStatistics (const char *path, double wallSeconds) {
+    Statistics s;
+    FILE *out;
+
+    if ((out = fopen(path, "w")) == NULL) {
+        return 1;
+    }
+
+    getStatistics(&s);
+    fprintf(out, "{\n  \"wall_seconds\": %.6f,\n  \"counters\": {", wallSeconds);
+    for (int c = 0; c < STAT_COUNTERS; c++) {
+        fprintf(out, "%s\n    \"%s\": %ld", c ? "," : "", counterNames[c], s.counters[c]);
+    }
+    fprintf(out, "\n  },\n  \"phases\": {");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        fprintf(out, "%s\n    \"%s\": {\"calls\": %ld, \"nanos\": %lld}", p ? "," : "",
+                phaseNames[p], s.phaseCalls[p], s.phaseNanos[p]);
+    }
+    fprintf(out, "\n  },\n  \"stages\": {");
+    for (int g = 0, n = 0; g < STAGE_COUNT; g++) {
+        if (s.stageThreads[g] == 0) {
+            continue;
+        }
+        fprintf(out, "%s\n    \"%s\": {\"threads\": %ld, \"batches\": %ld, "
+                "\"busy_nanos\": %lld, \"wait_nanos\": %lld, \"queued\": %ld}", n++ ? "," : "",
+                stageNames[g], s.stageThreads[g], s.stageBatches[g], s.stageBusyNanos[g],
+                s.stageWaitNanos[g], s.stageQueued[g]);
+    }
+    fprintf(out, "\n  }\n}\n");
+
+    return fclose(out) != 0;
+}
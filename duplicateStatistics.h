@@ -0,0 +1,131 @@
+/*
+********************************************************************************
+*                                
+* Filename     : duplicateStatistics.h
+* Programmer(s): Owatch
+* Created      : 2026/10/17
+* Description  : Per-thread scan counters and per-phase monotonic timers.
+********************************************************************************
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#if !defined(duplicateStatistics_h)
+#define duplicateStatistics_h
+
+/*
+ ******************************************************************************
+ *                        Symbolic Constants & Structures
+ ******************************************************************************
+ */
+
+/* Event counters */
+typedef enum {
+    STAT_DIRS_OPENED,
+    STAT_ENTRIES_READ,
+    STAT_STATS_ISSUED,
+    STAT_STAT_ERRORS,
+    STAT_FILES_TRACKED,
+    STAT_BYTES_STORED,
+    STAT_TABLE_PROBES,
+    STAT_OUTPUT_BYTES,
+    STAT_COUNTERS
+} StatCounter;
+
+/* Timed phases */
+typedef enum {
+    PHASE_OPENDIR,
+    PHASE_READDIR,
+    PHASE_STAT,
+    PHASE_HASH,
+    PHASE_INSERT,
+    PHASE_REPORT,
+    PHASE_COUNT
+} StatPhase;
+
+/* Stages of a pipelined scan */
+typedef enum {
+    STAGE_ENUMERATE,
+    STAGE_METADATA,
+    STAGE_KEY,
+    STAGE_INSERT,
+    STAGE_COUNT
+} StatStage;
+
+/* Counters and timers of one thread (or the merged totals) */
+typedef struct {
+    long counters[STAT_COUNTERS];
+    long phaseCalls[PHASE_COUNT];
+    long long phaseNanos[PHASE_COUNT];
+    long stageThreads[STAGE_COUNT];
+    long stageBatches[STAGE_COUNT];
+    long long stageBusyNanos[STAGE_COUNT];
+    long long stageWaitNanos[STAGE_COUNT];
+    long stageQueued[STAGE_COUNT];      // Input batches found waiting, summed.
+} Statistics;
+
+/* Nonzero if statistics are being collected */
+extern int statsEnabled;
+
+/* The calling thread's statistics */
+extern _Thread_local Statistics threadStatistics;
+
+/* Adds 'n' to counter 'c' (a single branch when disabled) */
+#define STAT_ADD(c, n)  do {                                                  \
+                            if (statsEnabled) {                               \
+                                threadStatistics.counters[(c)] += (n);        \
+                            }                                                 \
+                        } while (0)
+
+/* Declares 'v' and starts timing with it */
+#define STAT_BEGIN(v)   long long v = statsEnabled ? statsNanos() : 0
+
+/* Charges the time elapsed since STAT_BEGIN(v) to phase 'p' */
+#define STAT_END(p, v)  do {                                                  \
+                            if (statsEnabled) {                               \
+                                threadStatistics.phaseCalls[(p)]++;           \
+                                threadStatistics.phaseNanos[(p)] +=           \
+                                    statsNanos() - (v);                       \
+                            }                                                 \
+                        } while (0)
+
+/* Charges one thread's run of stage 's': 'batches' handled, 'busy' and 'wait'
+ * nanoseconds, and the sum of the input queue depths it found */
+#define STAT_STAGE(s, batches, busy, wait, queued)                            \
+    do {                                                                      \
+        if (statsEnabled) {                                                   \
+            threadStatistics.stageThreads[(s)]++;                             \
+            threadStatistics.stageBatches[(s)] += (batches);                  \
+            threadStatistics.stageBusyNanos[(s)] += (busy);                   \
+            threadStatistics.stageWaitNanos[(s)] += (wait);                   \
+            threadStatistics.stageQueued[(s)] += (queued);                    \
+        }                                                                     \
+    } while (0)
+
+/*
+ ******************************************************************************
+ *                                  Prototypes
+ ******************************************************************************
+ */
+
+ /* Returns the monotonic clock in nanoseconds */
+ static inline long long statsNanos (void) {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+ }
+
+ /* Folds the calling thread's statistics into the totals and resets them */
+ void mergeThreadStatistics (void);
+
+ /* Copies the merged totals into 'totals' */
+ void getStatistics (Statistics *totals);
+
+ /* Prints the merged totals in human readable form */
+ void printStatistics (FILE *out, double wallSeconds);
+
+ /* Writes the merged totals as JSON to 'path'. Signals error with nonzero value */
+ int exportStatistics (const char *path, double wallSeconds);
+
+#endif
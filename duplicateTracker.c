@@ -1,6 +1,6 @@
 /*
 ********************************************************************************
-*                                
+*
 * Filename     : duplicateTracker.c
 * Programmer(s): Owatch
 * Created      : 2017/08/29
@@ -9,6 +9,20 @@
 */
 
 #include "duplicateTracker.h"
+#include "duplicateStatistics.h"
+#include "duplicateMemory.h"
+#include "duplicateProbes.h"
+#include "duplicatePaths.h"
+#include "duplicateKernels.h"
+#include "duplicateEpoch.h"
+#include <ctype.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sched.h>
 
 /*
  ******************************************************************************
@@ -16,74 +30,405 @@
  ******************************************************************************
  */
 
+/* Index file signature and format version */
+#define INDEX_MAGIC     "DSINDEX"
+#define INDEX_VERSION   2
+
+/* Default number of buckets (a power of two) */
+#define DEFAULT_BUCKETS (1 << 16)
+
+/* Groups per bucket above which the table doubles */
+#define MAX_LOAD        0.75
+
+/* Chain length histogram classes (upper bounds, -1 is unbounded) */
+#define DIAG_CLASSES    8
+static const long diagBounds[DIAG_CLASSES] = {0, 1, 2, 4, 8, 16, 64, -1};
+
+/* Size of the table the tracker used before it could grow */
+#define LEGACY_SIZE     512000
+
 /* Printing format for a file node */
 #define FPRINT_FORMAT   "\t%d:\t%-32s%-32s\n"
 
-/* Structure representing a file */
+/* Buckets a report worker formats at a time (groups, if the report is sorted) */
+#define REPORT_CHUNK    4096
+#define REPORT_GROUPS   1024
+
+/* Formatted chunks per report worker that may wait to be written */
+#define REPORT_WINDOW   4
+
+/* Records a batch merge partitions at a time, and the bucket index bits it uses */
+#define BATCH_WINDOW    1024
+#define BATCH_BITS      8
+
+/* Records a batch merge looks ahead (table slots are fetched twice as far) */
+#define BATCH_AHEAD     4
+
+/* Structure representing a decoded file (an index record) */
 typedef struct file {
     char *filePath;
     time_t modified;
+    uint64_t size;
 } File;
 
-/* Structure representing a linked list node */
-struct node {
-    File file;
-    struct node *next;
+/* Longest key stored inside its group record */
+#define KEY_INLINE      23
+
+/*
+ * Structure representing the files sharing a key. Members are kept in one block
+ * as parallel arrays of 'capacity' mtimes, sizes and path ids, so filters and
+ * sorts stream through memory. Insertion appends; the members are put newest
+ * first (then by path) when the group is next read. The record fits a cache
+ * line, so a lookup's hash, length and (short) key checks touch one line.
+ *
+ * Readers in other threads (TrackerReader) share the table with the inserting
+ * thread without locks. Groups are never freed before the tracker, and are
+ * published with release stores: a new group at the head of its chain, a new
+ * member by the count that covers it. Blocks that get replaced (member blocks
+ * on growth or sorting, tables on growth) are retired to the tracker's epoch
+ * domain, so a reader may finish with them. A member block starts with its
+ * capacity, so a reader can find the arrays of the block it loaded. Table
+ * growth relinks the chains in place, so 'resizes' is odd while it runs, and a
+ * reader that misses a key during a resize looks again.
+ */
+struct group {
+    uint64_t hash;
+    struct group *next;
+    void *members;
+    uint32_t count, capacity;
+    uint16_t keyLength;
+    uint8_t sorted;             // Nonzero while the members are in order.
+    union {
+        char local[KEY_INLINE + 1];     // Keys up to KEY_INLINE bytes.
+        char *external;                 // Longer keys.
+    } key;
+};
+
+/* Structure representing a tracker */
+struct tracker {
+    struct group **table;
+    long buckets, groupCount, fileCount;
+    KeyPolicy keyPolicy;
+    TrackerAllocator allocator;
+    int accounted;      // Nonzero when using the accounting allocator.
+    int reportThreads;
+    TrackerStream stream;
+    void *streamContext;
+    PathStore *paths;
+    EpochDomain *epochs;
+    unsigned long resizes;
+};
+
+/* A reader's handle */
+struct trackerReader {
+    Tracker *tracker;
+    int slot;
 };
 
+/* Index file header (fields are stored in host byte order) */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t keyPolicy;
+    uint64_t count;
+} IndexHeader;
+
+/* A distinct key and the number of files carrying it */
+typedef struct {
+    const char *name;
+    long count;
+} KeyCount;
+
+/*
+ * A parallel report splits the table into chunks of REPORT_CHUNK buckets (or
+ * a sorted report's groups into chunks of REPORT_GROUPS). Workers claim chunks
+ * in order and format each into its own buffer; the caller writes the buffers
+ * out in the same order, so the output doesn't depend on the number of
+ * workers. A worker only claims a chunk once the chunk REPORT_WINDOW * workers
+ * before it has been written, which bounds the memory held by formatted text.
+ *
+ * Sorting collects a (key, group) pair per passing group, one run per worker
+ * over its share of the buckets. Runs are sorted in their workers and merged
+ * pairwise, the merges of a round running in parallel. Ties of the key are
+ * broken by name, so the order is total and independent of the table.
+ */
+
+/* A group and its sort key (smaller keys first) */
+typedef struct {
+    uint64_t key;
+    struct group *group;
+} SortPair;
+
+/* The passing groups of buckets [first, last), then a sorted run of pairs */
+typedef struct {
+    Tracker *tracker;
+    const TrackerFilter *filter;
+    ReportOrder order;
+    long first, last;
+    SortPair *pairs;
+    long count, capacity;
+    int failed;
+} SortRun;
+
+/* Two adjacent runs to merge into the first */
+typedef struct {
+    SortRun *left, *right;
+} SortMerge;
+
+/* A formatted chunk */
+typedef struct {
+    char *text;                 // NULL if it couldn't be buffered.
+    size_t length;
+    long groups;
+    int ready;
+} ReportChunk;
+
+/* Shared state of a parallel report */
+typedef struct {
+    Tracker *tracker;
+    const TrackerFilter *filter;
+    const SortPair *pairs;      // The groups in order, if sorted.
+    long pairCount;
+    int sorted;
+    long chunks, claimed, written;
+    long window;
+    ReportChunk *slots;         // Chunk c waits in slot c % window.
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} Report;
+
+/* Consumed index bytes a cursor keeps mapped before releasing them */
+#define CURSOR_RELEASE  (16L << 20)
+
+/* Output buffer of merged indexes */
+#define MERGE_BUFFER    (1L << 20)
+
+/* Sequential reader over a memory-mapped index file */
+typedef struct {
+    const unsigned char *data, *next, *end, *released;
+    size_t length;
+    IndexHeader header;
+    uint64_t remaining;
+    File file;                  // Current record (path points to 'path').
+    const char *key;            // Its key (points into 'path' or 'keyBuffer').
+    char path[MAX_PATH];
+    char keyBuffer[NAME_MAX + 1];
+} IndexCursor;
+
+/* Kinds of change a diff reports for a group */
+typedef enum {
+    DELTA_NEW,          // Became a duplicate.
+    DELTA_RESOLVED,     // No longer a duplicate.
+    DELTA_GROWN,        // Gained files.
+    DELTA_SHRUNK,       // Lost files.
+    DELTA_KINDS
+} DeltaKind;
+
+/* The files of one key in an index */
+typedef struct {
+    char key[NAME_MAX + 1];
+    long count;
+    uint64_t bytes;
+} IndexGroup;
+
+/* Maps a key to a bucket of a table with 'buckets' slots */
+typedef long (*BucketFunction)(const char *key, long buckets);
+
 /*
  ******************************************************************************
  *                             Auxillary Functions
  ******************************************************************************
  */
 
-/* Allocates and initializes a new list node */
-static struct node *newNode (const char *filePath, const time_t modified) {
-    struct node *n;
+/* Allocates 'size' bytes for a structure of the given category */
+static void *allocate (Tracker *t, MemCategory category, size_t size) {
+    if (t->accounted) {
+        return memAlloc(category, size, size);
+    }
+    return t->allocator.allocate(t->allocator.context, size);
+}
 
-    // Fail if node can't be allocated.
-    if ((n = malloc(sizeof(struct node))) == NULL) {
-        return NULL;
+/* Releases 'size' bytes at 'p', allocated for the given category */
+static void release (Tracker *t, MemCategory category, void *p, size_t size) {
+    if (t->accounted) {
+        memFree(category, p, size, size);
+    } else if (p != NULL) {
+        t->allocator.release(t->allocator.context, p, size);
     }
+}
 
-    // Fail if path field can't be allocated.
-    if (filePath == NULL || (n->file.filePath = malloc(MAX_PATH)) == NULL) {
+/* Resizes the 'oldSize' bytes at 'p' (may be NULL) to 'size', keeping them on failure */
+static void *reallocate (Tracker *t, MemCategory category, void *p, size_t oldSize,
+                         size_t size) {
+    void *q;
+
+    if (t->accounted) {
+        return memRealloc(category, p, oldSize, oldSize, size, size);
+    }
+    if ((q = t->allocator.allocate(t->allocator.context, size)) == NULL) {
         return NULL;
     }
+    if (p != NULL) {
+        memcpy(q, p, oldSize < size ? oldSize : size);
+        t->allocator.release(t->allocator.context, p, oldSize);
+    }
+    return q;
+}
 
-    // Assign fields.
-    strncpy(n->file.filePath, filePath, MAX_PATH);
-    n->file.modified = modified;
-    n->next = NULL;
+/* Path store allocations charged to the path category */
+static void *allocatePath (void *context, size_t size) {
+    (void)context;
+    return memAlloc(MEM_PATHS, size, size);
+}
 
-    return n;
+static void releasePath (void *context, void *p, size_t size) {
+    (void)context;
+    memFree(MEM_PATHS, p, size, size);
 }
 
-/* Recursively free's the given list node and it's linked nodes (Warning). */
-static void freeNode (struct node *n) {
-    if (n == NULL) {
-        return;
+/* Arrays of a member block (after its capacity) */
+static inline time_t *blockTimes (void *members) {
+    return (time_t *)((uint64_t *)members + 1);
+}
+
+static inline uint64_t *blockSizes (void *members) {
+    return (uint64_t *)(blockTimes(members) + *(uint64_t *)members);
+}
+
+static inline PathId *blockPaths (void *members) {
+    return (PathId *)(blockSizes(members) + *(uint64_t *)members);
+}
+
+/* Member arrays of group 'g' */
+static inline time_t *memberTimes (const struct group *g) {
+    return blockTimes(g->members);
+}
+
+static inline uint64_t *memberSizes (const struct group *g) {
+    return blockSizes(g->members);
+}
+
+static inline PathId *memberPaths (const struct group *g) {
+    return blockPaths(g->members);
+}
+
+/* Bytes of a member block holding 'capacity' members */
+static inline size_t memberBytes (uint32_t capacity) {
+    return sizeof(uint64_t) + capacity * (sizeof(time_t) + sizeof(uint64_t) + sizeof(PathId));
+}
+
+/* Deferred releases of member blocks and tables */
+static void releaseNodes (void *context, void *p, size_t size) {
+    release(context, MEM_NODES, p, size);
+}
+
+static void releaseTable (void *context, void *p, size_t size) {
+    release(context, MEM_TABLE, p, size);
+}
+
+/* Moves the members of 'g' to a block of 'capacity' (the order given by 'order',
+ * if not NULL). Signals error with nonzero value */
+static int moveMembers (Tracker *t, struct group *g, uint32_t capacity,
+                        const uint32_t *order) {
+    struct group moved = *g;
+    void *memberBlock = g->members;
+
+    if ((moved.members = allocate(t, MEM_NODES, memberBytes(capacity))) == NULL) {
+        return 1;
+    }
+    *(uint64_t *)moved.members = capacity;
+    moved.capacity = capacity;
+    for (uint32_t i = 0; i < g->count; i++) {
+        uint32_t from = order != NULL ? order[i] : i;
+        memberTimes(&moved)[i] = memberTimes(g)[from];
+        memberSizes(&moved)[i] = memberSizes(g)[from];
+        memberPaths(&moved)[i] = memberPaths(g)[from];
+    }
+
+    // Publish the new block before retiring the one readers may hold.
+    __atomic_store_n(&g->members, moved.members, __ATOMIC_RELEASE);
+    if (memberBlock != NULL) {
+        epochRetire(t->epochs, memberBlock, memberBytes(g->capacity), releaseNodes, t);
     }
-    free(n->next);
-    free(n->file.filePath);
-    free(n);
+    g->capacity = capacity;
+    return 0;
 }
 
 /* Returns the file name of a file from a given file path */
-static char *fileName (char *filePath) {
-    char *copy, *fileName = filePath;
+static const char *fileName (const char *filePath) {
+    const char *slash;
 
     if (filePath == NULL) {
         return "NUll";
     }
 
-    for (copy = filePath; *copy != '\0'; copy++) {
-        if (*copy == '/') {
-            fileName = copy + 1;
+    // Search backwards from the end (the library search is vectorised).
+    slash = strrchr(filePath, '/');
+    return slash != NULL ? slash + 1 : filePath;
+}
+
+/* Returns the key of 'name' under 'policy', NULL if too long */
+static const char *makeKey (KeyPolicy policy, const char *name, char buffer[NAME_MAX + 1]) {
+    size_t i;
+
+    if (policy == KEY_EXACT) {
+        return name;
+    }
+    for (i = 0; name[i] != '\0'; i++) {
+        if (i == NAME_MAX) {
+            return NULL;
         }
+        buffer[i] = tolower((unsigned char)name[i]);
+    }
+    buffer[i] = '\0';
+    return buffer;
+}
+
+/* Fills a view of the file at 'path' */
+static void pathView (const char *path, time_t modified, uint64_t size, FileView *view) {
+    view->path = path;
+    view->name = fileName(path);
+    view->nameLength = strlen(view->name);
+    view->directory = path;
+    view->directoryLength = view->name > path ? view->name - path - 1 : 0;
+    view->modified = modified;
+    view->size = size;
+}
+
+/* Fills a view of member 'i' of 'g', decoding its path into 'buffer'. Signals
+ * error (the path couldn't be decoded) with nonzero value */
+static int makeView (const Tracker *t, const struct group *g, uint32_t i,
+                     char buffer[MAX_PATH], FileView *view) {
+    if (pathStoreGet(t->paths, memberPaths(g)[i], buffer, NULL)) {
+        return 1;
+    }
+    pathView(buffer, memberTimes(g)[i], memberSizes(g)[i], view);
+    return 0;
+}
+
+/* Member mtimes are handed to the kernels as 64-bit integers */
+_Static_assert(sizeof(time_t) == sizeof(int64_t), "time_t must be 64 bits");
+
+/* Returns the member conditions of 'filter' as kernel bounds */
+static inline KernelFilter kernelFilter (const TrackerFilter *filter) {
+    return (KernelFilter){
+        .from = filter->from != 0 ? filter->from : INT64_MIN,
+        .to = filter->to != 0 ? filter->to : INT64_MAX,
+        .minSize = filter->minSize
+    };
+}
+
+/* Returns nonzero if file 'a' sorts before 'b' (newest first, then by path) */
+static int newerThan (const File *a, const File *b) {
+    if (a->modified != b->modified) {
+        return a->modified > b->modified;
     }
+    return strcmp(a->filePath, b->filePath) < 0;
+}
 
-    return fileName;
+/* Orders files newest first, then by path */
+static int compareNewest (const void *a, const void *b) {
+    return newerThan(a, b) ? -1 : newerThan(b, a);
 }
 
 /*
@@ -92,183 +437,1614 @@ static char *fileName (char *filePath) {
  ******************************************************************************
  */
 
- #define TBL_SIZE       512000
+ #define FNV_PRIME      1099511628211ULL
 
- #define FNV_PRIME      16777619
-
- #define FNV_OFFSET     2166136261
+ #define FNV_OFFSET     14695981039346656037ULL
 
 /* Computes FNV-1a hash for the provided key. Filenames should be ASCII encoded */
-long hash (const char *key) {
-    long hash = FNV_OFFSET;
-
-    do {
-        hash = hash ^ (*key);
-        hash *= FNV_PRIME;
-    } while (*++key != '\0');
+uint64_t trackerHash (const char *key) {
+    uint64_t hash = FNV_OFFSET;
 
-    hash %= TBL_SIZE;
-    return hash < 0 ? -hash : hash;
+    for (; *key != '\0'; key++) {
+        hash = (hash ^ (unsigned char)*key) * FNV_PRIME;
+    }
+    return hash;
 }
 
-/*
- ******************************************************************************
- *                             File Table Functions.
- ******************************************************************************
- */
+/* Returns the key of group 'g' */
+static inline const char *groupKey (const struct group *g) {
+    return g->keyLength <= KEY_INLINE ? g->key.local : g->key.external;
+}
 
-/* The internal file table */
-static struct node **fileTable;
+/* Returns the group for 'key' ('length' bytes), or NULL if there is none */
+static struct group *findGroup (const Tracker *t, const char *key, size_t length,
+                                uint64_t hash) {
+    struct group *g;
 
-/* The file count */
-static long fileCount;
+    for (g = t->table[hash & (t->buckets - 1)]; g != NULL; g = g->next) {
+        STAT_ADD(STAT_TABLE_PROBES, 1);
+        if (g->hash == hash && g->keyLength == length &&
+            memcmp(groupKey(g), key, length) == 0) {
+            return g;
+        }
+    }
+    return NULL;
+}
 
-/* Inserts a node into fileTable. Signals error with nonzero value */
-static int insertNode (struct node *n) {
-    int index = hash(fileName(n->file.filePath));
-    struct node *next, *head;
+/* Doubles the table. Signals error with nonzero value */
+static int growTable (Tracker *t) {
+    long buckets = 2 * t->buckets;
+    struct group **table;
 
-    // Don't insert into unallocated table.
-    if (fileTable == NULL) {
+    if ((table = allocate(t, MEM_TABLE, buckets * sizeof(struct group *))) == NULL) {
         return 1;
     }
-    //fprintf(stdout, "Inserting new node at index %d/%d\n", index, TBL_SIZE);
-    // Increment file count
-    fileCount++;
+    memset(table, 0, buckets * sizeof(struct group *));
+
+    // Relink every group by its stored hash (readers see 'resizes' odd meanwhile).
+    __atomic_store_n(&t->resizes, t->resizes + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (long i = 0; i < t->buckets; i++) {
+        struct group *g, *next;
+        for (g = t->table[i]; g != NULL; g = next) {
+            next = g->next;
+            __atomic_store_n(&g->next, table[g->hash & (buckets - 1)], __ATOMIC_RELEASE);
+            table[g->hash & (buckets - 1)] = g;
+        }
+    }
 
-    head = fileTable[index];
+    // Publish the table before its size, so a reader never indexes past its end.
+    PROBE_TABLE_RESIZE(t->buckets, buckets);
+    epochRetire(t->epochs, __atomic_exchange_n(&t->table, table, __ATOMIC_ACQ_REL),
+                t->buckets * sizeof(struct group *), releaseTable, t);
+    __atomic_store_n(&t->buckets, buckets, __ATOMIC_RELEASE);
+    __atomic_store_n(&t->resizes, t->resizes + 1, __ATOMIC_RELEASE);
+    return 0;
+}
 
-    // Put at head of list if no node yet, or newer than newest node.
-    if (head == NULL || difftime(n->file.modified, head->file.modified) > 0) {
-        fileTable[index] = n;
-        n->next = head;
-        return 0;
+/* Creates an empty group for 'key' ('length' bytes) in the table. Returns NULL on failure */
+static struct group *newGroup (Tracker *t, const char *key, size_t length, uint64_t hash) {
+    struct group *g;
+    long index;
+
+    if ((g = allocate(t, MEM_GROUPS, sizeof(struct group))) == NULL) {
+        return NULL;
+    }
+    if (length <= KEY_INLINE) {
+        memcpy(g->key.local, key, length + 1);
+    } else if ((g->key.external = allocate(t, MEM_GROUPS, length + 1)) != NULL) {
+        memcpy(g->key.external, key, length + 1);
+    } else {
+        release(t, MEM_GROUPS, g, sizeof(struct group));
+        return NULL;
+    }
+    g->keyLength = length;
+    g->hash = hash;
+    g->members = NULL;
+    g->count = 0;
+    g->capacity = 0;
+    g->sorted = 1;
+
+    index = hash & (t->buckets - 1);
+    g->next = t->table[index];
+    __atomic_store_n(&t->table[index], g, __ATOMIC_RELEASE);
+
+    // A failed resize only lengthens chains.
+    __atomic_store_n(&t->groupCount, t->groupCount + 1, __ATOMIC_RELAXED);
+    if (t->groupCount > t->buckets * MAX_LOAD) {
+        growTable(t);
+    }
+    return g;
+}
+
+/* Appends a file to group 'g'. Signals error with nonzero value */
+static int addMember (Tracker *t, struct group *g, const char *filePath, size_t length,
+                      time_t modified, uint64_t size) {
+    uint32_t n = g->count;
+    PathId path;
+
+    // Grow the block by doubling.
+    if (n == g->capacity && moveMembers(t, g, n ? 2 * n : 1, NULL)) {
+        return 1;
+    }
+    if (pathStoreAdd(t->paths, filePath, length, &path)) {
+        return 1;
     }
 
-    // Parse list until reached end or 'next' is an older node.
-    for (next = head->next; 
-         next != NULL && difftime(n->file.modified, next->file.modified) <= 0;
-         head = next, next = head->next)
-        ;
-    
-    head->next = n;
-    n->next = next;
+    // Still in order if it sorts after the last member.
+    if (g->sorted && n > 0 && memberTimes(g)[n - 1] <= modified) {
+        char last[MAX_PATH];
+        g->sorted = memberTimes(g)[n - 1] == modified &&
+                    pathStoreGet(t->paths, memberPaths(g)[n - 1], last, NULL) == 0 &&
+                    strcmp(last, filePath) < 0;
+    }
+    memberTimes(g)[n] = modified;
+    memberSizes(g)[n] = size;
+    memberPaths(g)[n] = path;
+    __atomic_store_n(&g->count, n + 1, __ATOMIC_RELEASE);
 
+    STAT_ADD(STAT_BYTES_STORED, memberBytes(1) + length + 1);
     return 0;
 }
 
+/* Member sort key */
+typedef struct {
+    time_t modified;
+    uint32_t index;
+    const char *path;           // Decoded only among equal mtimes.
+} MemberKey;
+
+/* Orders member keys newest first, then by path (or position until decoded) */
+static int compareMembers (const void *a, const void *b) {
+    const MemberKey *x = a, *y = b;
+
+    if (x->modified != y->modified) {
+        return x->modified > y->modified ? -1 : 1;
+    }
+    if (x->path != NULL && y->path != NULL) {
+        return strcmp(x->path, y->path);
+    }
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+/* Sorts runs of members with equal mtimes by path */
+static int sortTies (Tracker *t, const struct group *g, MemberKey *keys) {
+    char path[MAX_PATH], *text = NULL;
+    size_t *offsets = NULL, used = 0, capacity = 0;
+    int status = 0;
+
+    for (uint32_t start = 0, end; start < g->count && status == 0; start = end) {
+        for (end = start + 1; end < g->count && keys[end].modified == keys[start].modified; end++)
+            ;
+        if (end - start < 2) {
+            continue;
+        }
+
+        // Decode the run into one buffer, then point the keys into it.
+        if (offsets == NULL &&
+            (offsets = allocate(t, MEM_CACHES, g->count * sizeof(size_t))) == NULL) {
+            status = 1;
+            break;
+        }
+        used = 0;
+        for (uint32_t i = start; i < end && status == 0; i++) {
+            size_t length;
+            if (pathStoreGet(t->paths, memberPaths(g)[keys[i].index], path, &length)) {
+                status = 1;
+                break;
+            }
+            if (used + ++length > capacity) {
+                size_t grownCapacity = 2 * (used + length);
+                char *grown = reallocate(t, MEM_CACHES, text, capacity, grownCapacity);
+                if (grown == NULL) {
+                    status = 1;
+                    break;
+                }
+                text = grown;
+                capacity = grownCapacity;
+            }
+            memcpy(text + used, path, length);
+            offsets[i - start] = used;
+            used += length;
+        }
+        if (status == 0) {
+            for (uint32_t i = start; i < end; i++) {
+                keys[i].path = text + offsets[i - start];
+            }
+            qsort(keys + start, end - start, sizeof(MemberKey), compareMembers);
+        }
+    }
+
+    release(t, MEM_CACHES, text, capacity);
+    if (offsets != NULL) {
+        release(t, MEM_CACHES, offsets, g->count * sizeof(size_t));
+    }
+    return status;
+}
+
+/* Puts the members of 'g' newest first, then by path. Signals error with nonzero value */
+static int sortGroup (Tracker *t, struct group *g) {
+    MemberKey *keys;
+    uint32_t *order;
+    int status = 1;
+
+    if (g->sorted) {
+        return 0;
+    }
+    keys = allocate(t, MEM_CACHES, g->count * sizeof(MemberKey));
+    order = allocate(t, MEM_CACHES, 2 * g->count * sizeof(uint32_t));
+    if (keys != NULL && order != NULL) {
+        kernelSortDescending((const int64_t *)memberTimes(g), g->count, order, order + g->count);
+        for (uint32_t i = 0; i < g->count; i++) {
+            keys[i] = (MemberKey){memberTimes(g)[order[i]], order[i], NULL};
+        }
+        if (sortTies(t, g, keys) == 0) {
+            for (uint32_t i = 0; i < g->count; i++) {
+                order[i] = keys[i].index;
+            }
+            status = moveMembers(t, g, g->capacity, order);
+        }
+    }
+    g->sorted = status == 0;
+
+    release(t, MEM_CACHES, keys, g->count * sizeof(MemberKey));
+    release(t, MEM_CACHES, order, 2 * g->count * sizeof(uint32_t));
+    return status;
+}
+
 /*
  ******************************************************************************
  *                             Private Functions
  ******************************************************************************
  */
 
-/* Print's a file list. */
-static void printFileChain (struct node *n) {
-    int i = 1, count = 1;
+/* Print's the iterator's current group. Returns the number of bytes written */
+static int printGroup (TrackerIterator *it, const GroupView *group, FILE *out) {
+    char timeString[26];
+    int i = 1, written = 0;
+    FileView file;
 
-    // Do not print empty lists.
-    if (n == NULL) {
-        return;
+    // Output file details, headed by the newest file's name.
+    while (trackerNextMember(it, &file)) {
+        ctime_r(&file.modified, timeString);
+        timeString[strlen(timeString) - 1] = '\0';
+        if (i == 1) {
+            written = fprintf(out, "FILE (x%ld): %-64s\n", group->count, file.name);
+        }
+        written += fprintf(out, FPRINT_FORMAT, i++, timeString, file.path);
     }
 
-    // Count files.
-    for (struct node *copy = n->next; copy != NULL; count++, copy = copy->next);
+    // Output final newline buffer.
+    fputc('\n', out);
+    STAT_ADD(STAT_OUTPUT_BYTES, written + 1);
+    return written + 1;
+}
 
-    // Output file details.
-    fprintf(stdout, "FILE (x%d): %-64s\n", count, fileName(n->file.filePath));
-    do {
-        char *timeString =  ctime(&(n->file.modified));
-        timeString[strlen(timeString) - 1] = '\0';
-        fprintf(stdout, FPRINT_FORMAT, i++, timeString, n->file.filePath);
-    } while ((n = n->next) != NULL);
+/* Prints the groups in buckets [first, last). Returns the number of bytes written */
+static long printRange (Tracker *t, const TrackerFilter *filter, long first, long last,
+                        FILE *out, long *groups) {
+    TrackerIterator it;
+    GroupView group;
+    long bytes = 0;
 
-    // Output final newline buffer.
-    putchar('\n');
-} 
+    trackerBegin(t, filter, &it);
+    it.bucket = first - 1;
+    it.endBucket = last < t->buckets ? last : t->buckets;
+    while (trackerNextGroup(&it, &group)) {
+        bytes += printGroup(&it, &group, out);
+        (*groups)++;
+    }
+    return bytes;
+}
 
-/*
- ******************************************************************************
- *                             Public Functions
- ******************************************************************************
- */
+/* Prints chunk 'c' of a report. Returns the number of bytes written */
+static long printChunk (const Report *r, long c, FILE *out, long *groups) {
+    TrackerIterator it;
+    GroupView group;
+    long bytes = 0;
+
+    if (!r->sorted) {
+        return printRange(r->tracker, r->filter, c * REPORT_CHUNK, (c + 1) * REPORT_CHUNK,
+                          out, groups);
+    }
+    for (long i = c * REPORT_GROUPS; i < (c + 1) * REPORT_GROUPS && i < r->pairCount; i++) {
+        trackerBegin(r->tracker, r->filter, &it);
+        it.single = 1;
+        it.group = r->pairs[i].group;
+        if (trackerNextGroup(&it, &group)) {
+            bytes += printGroup(&it, &group, out);
+            (*groups)++;
+        }
+    }
+    return bytes;
+}
 
-/* Hashes and logs the given file details. Signals error with nonzero return */
-int trackFile (const char *fileName, const time_t modified) {
-    struct node *n;
+/* Formats chunks as the window allows, until all are claimed */
+static void *reportWorker (void *argument) {
+    Report *r = argument;
 
-    // Return nonzero error if allocation of node failed. 
-    if ((n = newNode(fileName, modified)) == NULL) {
-        return 1;
+    for (;;) {
+        ReportChunk chunk = {NULL, 0, 0, 1};
+        FILE *buffer;
+        long c;
+
+        pthread_mutex_lock(&r->lock);
+        while (r->claimed < r->chunks && r->claimed >= r->written + r->window) {
+            pthread_cond_wait(&r->changed, &r->lock);
+        }
+        c = r->claimed++;
+        pthread_mutex_unlock(&r->lock);
+        if (c >= r->chunks) {
+            break;
+        }
+
+        // Unbuffered chunks are left for the writer to print directly.
+        if ((buffer = open_memstream(&chunk.text, &chunk.length)) != NULL) {
+            printChunk(r, c, buffer, &chunk.groups);
+            if (fclose(buffer) != 0) {
+                free(chunk.text);
+                chunk.text = NULL;
+                chunk.groups = 0;
+            }
+        }
+
+        pthread_mutex_lock(&r->lock);
+        r->slots[c % r->window] = chunk;
+        pthread_cond_broadcast(&r->changed);
+        pthread_mutex_unlock(&r->lock);
     }
 
-    //fprintf(stdout, "inserting %s...\n", fileName);
-    return insertNode(n);
+    if (statsEnabled) {
+        mergeThreadStatistics();
+    }
+    return NULL;
 }
- 
-/* Initializes the internal file table */
-int initializeFileTable (void) {
-    
-    // Ensure all are initialized to NULL.
-    if ((fileTable = calloc(TBL_SIZE, sizeof(struct node *))) == NULL) {
-        return 1;
+
+/* Prints the report with 'workers' threads. Returns the number of bytes written,
+ * or -1 if the workers couldn't be started (nothing is printed then) */
+static long printParallel (Report *r, int workers, FILE *out, long *groups) {
+    pthread_t *threads;
+    long bytes = 0;
+    int started = 0;
+
+    r->window = (long)REPORT_WINDOW * workers;
+    if ((r->slots = allocate(r->tracker, MEM_CACHES, r->window * sizeof(ReportChunk))) != NULL) {
+        memset(r->slots, 0, r->window * sizeof(ReportChunk));
     }
-    return 0;
+    threads = malloc(workers * sizeof(pthread_t));
+    while (r->slots != NULL && threads != NULL && started < workers &&
+           pthread_create(&threads[started], NULL, reportWorker, r) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        release(r->tracker, MEM_CACHES, r->slots, r->window * sizeof(ReportChunk));
+        free(threads);
+        return -1;
+    }
+
+    // Write the chunks out in order as they become ready.
+    for (long c = 0; c < r->chunks; c++) {
+        ReportChunk *slot = &r->slots[c % r->window], chunk;
+
+        pthread_mutex_lock(&r->lock);
+        while (!slot->ready) {
+            pthread_cond_wait(&r->changed, &r->lock);
+        }
+        chunk = *slot;
+        slot->ready = 0;
+        r->written = c + 1;
+        pthread_cond_broadcast(&r->changed);
+        pthread_mutex_unlock(&r->lock);
+
+        if (chunk.text == NULL) {
+            bytes += printChunk(r, c, out, groups);
+        } else {
+            fwrite(chunk.text, 1, chunk.length, out);
+            bytes += chunk.length;
+            *groups += chunk.groups;
+            free(chunk.text);
+        }
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    release(r->tracker, MEM_CACHES, r->slots, r->window * sizeof(ReportChunk));
+    free(threads);
+    return bytes;
 }
- 
-/* Prints all duplicate files logged in the filetable by desc modified date */
-void printFileTable (void) {
-    
-    // Don't print an uninitialized fileTable.
-    if (fileTable == NULL) {
-        fprintf(stdout, "FileTable is NULL!\n");
-        return;
+
+/* Prints a report, in parallel if there are several workers and chunks */
+static void printReport (Report *r, FILE *out) {
+    int workers = r->tracker->reportThreads < r->chunks ? r->tracker->reportThreads : r->chunks;
+    long groups = 0, bytes = -1;
+
+    PROBE_REPORT_START();
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->changed, NULL);
+    if (workers > 1) {
+        bytes = printParallel(r, workers, out, &groups);
     }
+    if (bytes < 0) {
+        bytes = 0;
+        for (long c = 0; c < r->chunks; c++) {
+            bytes += printChunk(r, c, out, &groups);
+        }
+    }
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->changed);
+    PROBE_REPORT_DONE(groups, bytes);
+}
+
+/* Runs 'work' on 'count' tasks of 'size' bytes, each in its own thread (the
+ * first in the caller's, and any that can't be started after it) */
+static void runTasks (void *(*work)(void *), void *tasks, size_t size, long count) {
+    pthread_t *threads = malloc(count * sizeof(pthread_t));
+    char *started = calloc(count, 1);
 
-    // Print each list of duplicate files.
-    for (int i = 0; i < TBL_SIZE; i++) {
-        printFileChain(fileTable[i]);
+    for (long i = 1; threads != NULL && started != NULL && i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, work, (char *)tasks + i * size) == 0;
+    }
+    for (long i = 0; i < count; i++) {
+        if (started == NULL || !started[i]) {
+            work((char *)tasks + i * size);
+        }
+    }
+    for (long i = 1; started != NULL && i < count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
     }
+    free(threads);
+    free(started);
 }
 
- /* Searches the file table for a particular file name. Then prints results */
- void findFile (const char *fileName) {
-    int index;
-    // Don't search if the fileTable is uninitialized.
-    if (fileTable == NULL) {
-        fprintf(stderr, "Error: File Table is uninitialized!\n");
-        return;
+/* Returns the sort key of a passing group (its members in order) */
+static uint64_t sortKey (ReportOrder order, const struct group *g, const TrackerFilter *filter,
+                         const GroupView *view) {
+    KernelFilter bounds = kernelFilter(filter);
+    uint32_t selected[ITERATOR_CHUNK], n = 0;
+    uint64_t key = 0;
+
+    if (order == ORDER_NAME) {
+        for (int i = 0; i < 8 && i < g->keyLength; i++) {
+            key |= (uint64_t)(unsigned char)groupKey(g)[i] << (56 - 8 * i);
+        }
+        return key;
+    }
+    if (order == ORDER_COUNT) {
+        return ~(uint64_t)view->count;
     }
 
-    // Compute hash, search table.
-    if (fileTable[(index = hash(fileName))] == NULL) {
-        fprintf(stdout, "Sorry, no match found!\n");
-    } else {
-        printFileChain(fileTable[index]);
+    // The newest passing member is the first; the others are waste.
+    for (uint32_t start = 0; n == 0 && start < g->count; start += ITERATOR_CHUNK) {
+        uint32_t end = start + ITERATOR_CHUNK < g->count ? start + ITERATOR_CHUNK : g->count;
+        n = kernelCompact((const int64_t *)memberTimes(g), memberSizes(g), start, end,
+                          &bounds, selected);
     }
- }
+    if (order == ORDER_WASTED) {
+        return ~(view->bytes - memberSizes(g)[selected[0]]);
+    }
+    return ~((uint64_t)memberTimes(g)[selected[0]] ^ (1ULL << 63));
+}
 
-/* Returns the total number of files in the file table */
-long getFileCount (void) {
-    return fileCount;
+/* Orders sort pairs by key, then by name */
+static int comparePairs (const void *a, const void *b) {
+    const SortPair *x = a, *y = b;
+
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return strcmp(groupKey(x->group), groupKey(y->group));
 }
- 
-/* Free's the internal file table (and all files) */
-int freeFileTable (void) {
 
-    // Do not free if fileTable already NULL.
-    if (fileTable == NULL) {
-        return 1;
+/* Collects and sorts the pairs of a run */
+static void *collectRun (void *argument) {
+    SortRun *run = argument;
+    TrackerIterator it;
+    GroupView group;
+
+    trackerBegin(run->tracker, run->filter, &it);
+    it.bucket = run->first - 1;
+    it.endBucket = run->last;
+    while (trackerNextGroup(&it, &group)) {
+        if (run->count == run->capacity) {
+            long capacity = 2 * run->capacity + 1024;
+            SortPair *grown = reallocate(run->tracker, MEM_CACHES, run->pairs,
+                                         run->capacity * sizeof(SortPair),
+                                         capacity * sizeof(SortPair));
+            if (grown == NULL) {
+                run->failed = 1;
+                return NULL;
+            }
+            run->pairs = grown;
+            run->capacity = capacity;
+        }
+        run->pairs[run->count++] = (SortPair){sortKey(run->order, it.group, &it.filter, &group),
+                                              it.group};
     }
+    qsort(run->pairs, run->count, sizeof(SortPair), comparePairs);
+    return NULL;
+}
+
+/* Frees the pairs of a run */
+static void freePairs (SortRun *run) {
+    release(run->tracker, MEM_CACHES, run->pairs, run->capacity * sizeof(SortPair));
+    run->pairs = NULL;
+    run->count = run->capacity = 0;
+}
 
-    // Free all nodes.
-    for (int i = 0; i < TBL_SIZE; i++) {
-        freeNode(fileTable[i]);
+/* Merges a run into the one before it */
+static void *mergeRuns (void *argument) {
+    SortMerge *m = argument;
+    SortRun *a = m->left, *b = m->right;
+    long i = 0, j = 0, n = 0, count = a->count + b->count, capacity = count + 1;
+    SortPair *merged;
+
+    if ((merged = allocate(a->tracker, MEM_CACHES, capacity * sizeof(SortPair))) == NULL) {
+        a->failed = 1;
+        return NULL;
     }
+    while (i < a->count && j < b->count) {
+        merged[n++] = comparePairs(&a->pairs[i], &b->pairs[j]) <= 0 ? a->pairs[i++]
+                                                                    : b->pairs[j++];
+    }
+    memcpy(merged + n, a->pairs + i, (a->count - i) * sizeof(SortPair));
+    n += a->count - i;
+    memcpy(merged + n, b->pairs + j, (b->count - j) * sizeof(SortPair));
+
+    freePairs(a);
+    freePairs(b);
+    a->pairs = merged;
+    a->count = count;
+    a->capacity = capacity;
+    return NULL;
+}
 
-    // Free table, NULL pointer.
-    free(fileTable);
-    fileTable = NULL;
+/* Sets the passing groups of the table into one sorted run (runs[0]) using one
+ * run per report worker. Signals error with nonzero value */
+static int sortGroups (Tracker *t, const TrackerFilter *filter, ReportOrder order,
+                       SortRun *runs, long count) {
+    SortMerge *merges = allocate(t, MEM_CACHES, (count / 2 + 1) * sizeof(SortMerge));
+    int failed = merges == NULL;
 
-    return 0;
+    for (long i = 0; i < count; i++) {
+        runs[i] = (SortRun){t, filter, order, t->buckets * i / count,
+                            t->buckets * (i + 1) / count, NULL, 0, 0, 0};
+    }
+    if (!failed) {
+        runTasks(collectRun, runs, sizeof(SortRun), count);
+    }
+
+    // Merge neighbouring runs, doubling the width each round.
+    for (long width = 1; width < count && !failed; width *= 2) {
+        long n = 0;
+        for (long i = 0; i < count; i++) {
+            failed |= runs[i].failed;
+        }
+        for (long i = 0; i + width < count && !failed; i += 2 * width) {
+            merges[n++] = (SortMerge){&runs[i], &runs[i + width]};
+        }
+        if (!failed) {
+            runTasks(mergeRuns, merges, sizeof(SortMerge), n);
+        }
+    }
+    for (long i = 0; i < count; i++) {
+        failed |= runs[i].failed;
+    }
+
+    release(t, MEM_CACHES, merges, (count / 2 + 1) * sizeof(SortMerge));
+    return failed;
+}
+
+/* Returns all groups (caller frees), NULL on failure */
+static struct group **allGroups (const Tracker *t) {
+    struct group **groups;
+    long n = 0;
+
+    if ((groups = malloc((t->groupCount + 1) * sizeof(struct group *))) == NULL) {
+        return NULL;
+    }
+    for (long i = 0; i < t->buckets; i++) {
+        for (struct group *g = t->table[i]; g != NULL; g = g->next) {
+            groups[n++] = g;
+        }
+    }
+    return groups;
+}
+
+/* Orders groups by key */
+static int compareGroups (const void *a, const void *b) {
+    const struct group *x = *(struct group * const *)a, *y = *(struct group * const *)b;
+    return strcmp(groupKey(x), groupKey(y));
+}
+
+/* The table's own bucket function */
+static long currentBucket (const char *key, long buckets) {
+    return (long)(trackerHash(key) & (uint64_t)(buckets - 1));
+}
+
+/* The bucket function of the fixed table the tracker used to have */
+static long legacyBucket (const char *key, long buckets) {
+    long hash = 2166136261;
+
+    (void)buckets;
+    do {
+        hash = hash ^ (*key);
+        hash *= 16777619;
+    } while (*key != '\0' && *++key != '\0');
+
+    hash %= LEGACY_SIZE;
+    return hash < 0 ? -hash : hash;
+}
+
+/* Prints the bucket distribution 'bucketOf' gives the keys in 'buckets' slots */
+static void printDistribution (FILE *out, const char *label, const KeyCount *keys,
+                               long keyCount, long fileCount, long buckets,
+                               BucketFunction bucketOf) {
+    long *files = calloc(buckets, sizeof(long)), *names = calloc(buckets, sizeof(long));
+    long classes[DIAG_CLASSES] = {0}, used = 0, maxChain = 0, colliding = 0;
+    double hitCost = 0.0, keyCost = 0.0;
+
+    if (files == NULL || names == NULL) {
+        free(files);
+        free(names);
+        return;
+    }
+
+    // Chains hold every name that falls into the bucket.
+    for (long k = 0; k < keyCount; k++) {
+        long b = bucketOf(keys[k].name, buckets);
+        files[b] += keys[k].count;
+        names[b]++;
+    }
+    for (long b = 0; b < buckets; b++) {
+        int c = 0;
+        while (diagBounds[c] != -1 && names[b] > diagBounds[c]) {
+            c++;
+        }
+        classes[c]++;
+        used += names[b] > 0;
+        maxChain = names[b] > maxChain ? names[b] : maxChain;
+        colliding += names[b] > 1 ? names[b] : 0;
+    }
+
+    // A lookup walks the chain up to its key, on average half of it.
+    for (long k = 0; k < keyCount; k++) {
+        long chain = names[bucketOf(keys[k].name, buckets)];
+        hitCost += (chain + 1) / 2.0 * keys[k].count;
+        keyCost += (chain + 1) / 2.0;
+    }
+
+    fprintf(out, "%s (%ld buckets):\n", label, buckets);
+    fprintf(out, "\tload factor       %.4f names/bucket, %.4f files/bucket\n",
+            (double)keyCount / buckets, (double)fileCount / buckets);
+    fprintf(out, "\tbuckets used      %ld (%.2f%%)\n", used, 100.0 * used / buckets);
+    fprintf(out, "\tmax chain         %ld\n", maxChain);
+    fprintf(out, "\tcolliding names   %ld of %ld (share a bucket with another name)\n",
+            colliding, keyCount);
+    fprintf(out, "\tlookup cost       %.2f probes/file, %.2f probes/name, %.2f probes/miss\n",
+            fileCount ? hitCost / fileCount : 0.0, keyCount ? keyCost / keyCount : 0.0,
+            (double)keyCount / buckets);
+    fprintf(out, "\tchain lengths    ");
+    for (int c = 0; c < DIAG_CLASSES; c++) {
+        if (diagBounds[c] == -1) {
+            fprintf(out, " >%ld:%ld\n", diagBounds[c - 1], classes[c]);
+        } else {
+            fprintf(out, " <=%ld:%ld", diagBounds[c], classes[c]);
+        }
+    }
+
+    free(files);
+    free(names);
+}
+
+/* Writes a file as an index record. Signals error with nonzero value */
+static int writeRecord (FILE *index, const File *file) {
+    int64_t modified = file->modified;
+    uint64_t size = file->size;
+    uint16_t length = strlen(file->filePath);
+
+    return fwrite(&modified, sizeof(modified), 1, index) != 1 ||
+           fwrite(&size, sizeof(size), 1, index) != 1 ||
+           fwrite(&length, sizeof(length), 1, index) != 1 ||
+           fwrite(file->filePath, 1, length, index) != length;
+}
+
+/* Maps an index file for reading. Signals error with nonzero value */
+static int openCursor (IndexCursor *c, const char *indexPath) {
+    struct stat statBuffer;
+    void *data;
+    int fd;
+
+    if ((fd = open(indexPath, O_RDONLY)) == -1) {
+        return 1;
+    }
+    if (fstat(fd, &statBuffer) == -1 || (size_t)statBuffer.st_size < sizeof(IndexHeader) ||
+        (data = mmap(NULL, statBuffer.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return 1;
+    }
+    close(fd);
+
+    c->data = c->next = c->released = data;
+    c->length = statBuffer.st_size;
+    c->end = c->data + c->length;
+    memcpy(&c->header, c->data, sizeof(IndexHeader));
+    c->next += sizeof(IndexHeader);
+    c->remaining = c->header.count;
+    c->file.filePath = c->path;
+    if (memcmp(c->header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        c->header.version < 1 || c->header.version > INDEX_VERSION) {
+        munmap((void *)c->data, c->length);
+        return 1;
+    }
+    madvise((void *)c->data, c->length, MADV_SEQUENTIAL);
+    return 0;
+}
+
+/* Reads the next record. Returns 1 if read, 0 at the end, -1 if corrupt */
+static int advanceCursor (IndexCursor *c) {
+    size_t fixed = c->header.version > 1 ? 18 : 10;
+    uint16_t length;
+    int64_t modified;
+
+    if (c->remaining == 0) {
+        return 0;
+    }
+    if ((size_t)(c->end - c->next) < fixed) {
+        return -1;
+    }
+
+    // Records are unaligned: copy the fields out (version 1 carries no sizes).
+    memcpy(&modified, c->next, sizeof(modified));
+    c->file.size = 0;
+    if (c->header.version > 1) {
+        memcpy(&c->file.size, c->next + 8, sizeof(uint64_t));
+    }
+    memcpy(&length, c->next + fixed - 2, sizeof(length));
+    c->next += fixed;
+    if (length >= MAX_PATH || (size_t)(c->end - c->next) < length) {
+        return -1;
+    }
+    memcpy(c->path, c->next, length);
+    c->path[length] = '\0';
+    c->next += length;
+    c->file.modified = (time_t)modified;
+    c->remaining--;
+
+    if ((c->key = makeKey(c->header.keyPolicy, fileName(c->path), c->keyBuffer)) == NULL) {
+        return -1;
+    }
+
+    // Drop pages already consumed so long reads keep a bounded footprint.
+    if (c->next - c->released > CURSOR_RELEASE) {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t span = ((c->next - c->released) / page) * page;
+        madvise((void *)c->released, span, MADV_DONTNEED);
+        c->released += span;
+    }
+    return 1;
+}
+
+/* Unmaps an index file */
+static void closeCursor (IndexCursor *c) {
+    munmap((void *)c->data, c->length);
+}
+
+/* Returns nonzero if cursor 'a's record merges before 'b's (key, then newest first) */
+static int cursorBefore (const IndexCursor *a, const IndexCursor *b) {
+    int order = strcmp(a->key, b->key);
+    return order != 0 ? order < 0 : newerThan(&a->file, &b->file);
+}
+
+/* Restores the merge heap upwards from 'i' */
+static void siftUp (const IndexCursor *cursors, long *heap, long i) {
+    while (i > 0 && cursorBefore(&cursors[heap[i]], &cursors[heap[(i - 1) / 2]])) {
+        long parent = (i - 1) / 2, swap = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = swap;
+        i = parent;
+    }
+}
+
+/* Restores the merge heap of 'size' inputs downwards from 'i' */
+static void siftDown (const IndexCursor *cursors, long *heap, long size, long i) {
+    for (;;) {
+        long least = i, left = 2 * i + 1, right = left + 1, swap;
+
+        if (left < size && cursorBefore(&cursors[heap[left]], &cursors[heap[least]])) {
+            least = left;
+        }
+        if (right < size && cursorBefore(&cursors[heap[right]], &cursors[heap[least]])) {
+            least = right;
+        }
+        if (least == i) {
+            return;
+        }
+        swap = heap[i];
+        heap[i] = heap[least];
+        heap[least] = swap;
+        i = least;
+    }
+}
+
+/* Reads the next group of consecutive records sharing a key. Returns 1 if read,
+ * 0 at the end, -1 if corrupt. '*pending' is nonzero while the cursor holds a
+ * record not yet consumed */
+static int nextIndexGroup (IndexCursor *c, int *pending, IndexGroup *g) {
+    int read = 1;
+
+    if (!*pending && (read = advanceCursor(c)) != 1) {
+        return read;
+    }
+    strcpy(g->key, c->key);
+    g->count = 0;
+    g->bytes = 0;
+    while (read == 1 && strcmp(c->key, g->key) == 0) {
+        g->count++;
+        g->bytes += c->file.size;
+        read = advanceCursor(c);
+    }
+    *pending = read == 1;
+    return read == -1 ? -1 : 1;
+}
+
+/* Classifies the change of a key from 'before' to 'after' files, -1 if none */
+static int deltaKind (long before, long after) {
+    if (before < 2) {
+        return after < 2 ? -1 : DELTA_NEW;
+    }
+    if (after < 2) {
+        return DELTA_RESOLVED;
+    }
+    return after > before ? DELTA_GROWN : after < before ? DELTA_SHRUNK : -1;
+}
+
+/*
+ ******************************************************************************
+ *                             Public Functions
+ ******************************************************************************
+ */
+
+/* Creates a tracker ('config' may be NULL). Returns NULL on failure */
+Tracker *trackerCreate (const TrackerConfig *config) {
+    TrackerConfig defaults = {0, KEY_EXACT, NULL, 0, NULL, NULL};
+    TrackerAllocator paths;
+    Tracker bootstrap, *t;
+    long buckets = 1;
+
+    if (config == NULL) {
+        config = &defaults;
+    }
+
+    // Allocate the handle itself through the configured allocator.
+    memset(&bootstrap, 0, sizeof(Tracker));
+    bootstrap.accounted = (config->allocator == NULL);
+    if (!bootstrap.accounted) {
+        bootstrap.allocator = *config->allocator;
+        paths = bootstrap.allocator;
+    }
+    if ((t = allocate(&bootstrap, MEM_TABLE, sizeof(Tracker))) == NULL) {
+        return NULL;
+    }
+    *t = bootstrap;
+    t->keyPolicy = config->keyPolicy;
+    t->stream = config->stream;
+    t->streamContext = config->streamContext;
+
+    // A user allocator may not be thread safe, so it gets one report worker.
+    t->reportThreads = config->reportThreads;
+    if (t->reportThreads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        t->reportThreads = t->accounted && cpus > 1 ? cpus : 1;
+    }
+
+    // Paths go to their own store, charged to the path category.
+    if (t->accounted) {
+        paths = (TrackerAllocator){allocatePath, releasePath, NULL};
+    }
+    if ((t->epochs = epochCreate()) == NULL ||
+        (t->paths = pathStoreCreate(&paths, t->epochs)) == NULL) {
+        epochDestroy(t->epochs);
+        release(t, MEM_TABLE, t, sizeof(Tracker));
+        return NULL;
+    }
+
+    // Round the table up to a power of two.
+    while (buckets < (config->initialBuckets > 0 ? config->initialBuckets : DEFAULT_BUCKETS)) {
+        buckets <<= 1;
+    }
+    if ((t->table = allocate(t, MEM_TABLE, buckets * sizeof(struct group *))) == NULL) {
+        pathStoreDestroy(t->paths);
+        epochDestroy(t->epochs);
+        release(t, MEM_TABLE, t, sizeof(Tracker));
+        return NULL;
+    }
+    memset(t->table, 0, buckets * sizeof(struct group *));
+    t->buckets = buckets;
+
+    PROBE_TABLE_RESIZE(0, buckets);
+    return t;
+}
+
+/* Hashes and logs the given file details. Signals error with nonzero value */
+int trackerInsert (Tracker *t, const char *filePath, time_t modified, uint64_t size) {
+    TrackerRecord record = {filePath, filePath != NULL ? strlen(filePath) : 0, NULL, 0, 0,
+                            modified, size};
+    char buffer[NAME_MAX + 1];
+
+    if (t == NULL || trackerPrepare(t, &record, buffer)) {
+        PROBE_TRACK_START(filePath, record.pathLength);
+        PROBE_TRACK_DONE(1, t != NULL ? t->fileCount : 0);
+        return 1;
+    }
+    return trackerInsertPrepared(t, &record);
+}
+
+/* Sets the key and hash of 'record' from its path. Signals error with nonzero value */
+int trackerPrepare (const Tracker *t, TrackerRecord *record, char buffer[NAME_MAX + 1]) {
+    // Reject missing paths and over-long names.
+    if (record->path == NULL ||
+        (record->key = makeKey(t->keyPolicy, fileName(record->path), buffer)) == NULL) {
+        return 1;
+    }
+    record->keyLength = strlen(record->key);
+
+    STAT_BEGIN(hashStart);
+    record->hash = trackerHash(record->key);
+    STAT_END(PHASE_HASH, hashStart);
+    return 0;
+}
+
+/* Passes members 'first' onwards of group 'g' to the tracker's stream */
+static void streamMembers (const Tracker *t, const struct group *g, uint32_t first) {
+    char path[MAX_PATH];
+    FileView view;
+
+    // Members whose paths can't be decoded are left out.
+    for (uint32_t i = first; i < g->count; i++) {
+        if (makeView(t, g, i, path, &view) == 0) {
+            t->stream(t->streamContext, groupKey(g), g->count, &view);
+        }
+    }
+}
+
+/* Tracks a prepared record. Signals error with nonzero value */
+int trackerInsertPrepared (Tracker *t, const TrackerRecord *record) {
+    STAT_BEGIN(start);
+    PROBE_TRACK_START(record->path, record->pathLength);
+    struct group *g;
+
+    // Return nonzero error if allocation of group or member failed.
+    if (((g = findGroup(t, record->key, record->keyLength, record->hash)) == NULL &&
+         (g = newGroup(t, record->key, record->keyLength, record->hash)) == NULL) ||
+        addMember(t, g, record->path, record->pathLength, record->modified, record->size)) {
+        PROBE_TRACK_DONE(1, t->fileCount);
+        return 1;
+    }
+
+    __atomic_store_n(&t->fileCount, t->fileCount + 1, __ATOMIC_RELAXED);
+    STAT_ADD(STAT_FILES_TRACKED, 1);
+    STAT_END(PHASE_INSERT, start);
+    PROBE_TRACK_DONE(0, t->fileCount);
+
+    // Stream the group once it holds a duplicate, then each file it gains.
+    if (t->stream != NULL && g->count >= 2) {
+        streamMembers(t, g, g->count == 2 ? 0 : g->count - 1);
+    }
+    return 0;
+}
+
+/* Tracks 'count' records of a window in partition order. Returns the number not tracked */
+static long mergeWindow (Tracker *t, const TrackerRecord *records, uint32_t count) {
+    uint32_t order[BATCH_WINDOW], offsets[(1 << BATCH_BITS) + 1] = {0};
+    int shift = __builtin_ctzl(t->buckets) > BATCH_BITS ?
+                __builtin_ctzl(t->buckets) - BATCH_BITS : 0;
+    long mask = t->buckets - 1, failed = 0;
+
+    // Counting sort by the top bucket bits, so the merge walks the table in order.
+    for (uint32_t i = 0; i < count; i++) {
+        offsets[((records[i].hash & mask) >> shift) + 1]++;
+    }
+    for (int p = 0; p < (1 << BATCH_BITS); p++) {
+        offsets[p + 1] += offsets[p];
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        order[offsets[(records[i].hash & mask) >> shift]++] = i;
+    }
+
+    // Fetch table slots, then the chain heads they hold, ahead of the inserts.
+    for (uint32_t i = 0; i < count; i++) {
+        if (i + 2 * BATCH_AHEAD < count) {
+            __builtin_prefetch(&t->table[records[order[i + 2 * BATCH_AHEAD]].hash &
+                                         (t->buckets - 1)]);
+        }
+        if (i + BATCH_AHEAD < count) {
+            struct group *g = t->table[records[order[i + BATCH_AHEAD]].hash &
+                                       (t->buckets - 1)];
+            if (g != NULL) {
+                __builtin_prefetch(g);
+            }
+        }
+        failed += trackerInsertPrepared(t, &records[order[i]]) != 0;
+    }
+    return failed;
+}
+
+/* Tracks 'count' prepared records in one merge. Returns the number not tracked */
+long trackerInsertBatch (Tracker *t, const TrackerRecord *records, long count) {
+    long failed = 0;
+
+    for (long i = 0; i < count; i += BATCH_WINDOW) {
+        failed += mergeWindow(t, records + i, count - i < BATCH_WINDOW ? count - i :
+                                                                          BATCH_WINDOW);
+    }
+    return failed;
+}
+
+/* Visits the files named 'fileName', newest first. Returns their count, or -1
+ * if a path couldn't be decoded */
+long trackerQuery (Tracker *t, const char *fileName, TrackerVisitor visit,
+                   void *context) {
+    char buffer[NAME_MAX + 1];
+    char path[MAX_PATH];
+    const char *key;
+    struct group *g;
+    FileView view;
+
+    if ((key = makeKey(t->keyPolicy, fileName, buffer)) == NULL ||
+        (g = findGroup(t, key, strlen(key), trackerHash(key))) == NULL) {
+        return 0;
+    }
+    // Counting alone needs no order.
+    if (visit != NULL) {
+        sortGroup(t, g);
+    }
+    for (uint32_t i = 0; visit != NULL && i < g->count; i++) {
+        if (makeView(t, g, i, path, &view)) {
+            return -1;
+        }
+        if (visit(context, &view)) {
+            break;
+        }
+    }
+    return g->count;
+}
+
+/* Returns the group for 'key' as a reader sees it, or NULL if there is none */
+static const struct group *readGroup (Tracker *t, const char *key, size_t length,
+                                      uint64_t hash) {
+    for (;;) {
+        unsigned long resizes = __atomic_load_n(&t->resizes, __ATOMIC_ACQUIRE);
+        long buckets = __atomic_load_n(&t->buckets, __ATOMIC_ACQUIRE);
+        struct group **table = __atomic_load_n(&t->table, __ATOMIC_ACQUIRE);
+        long steps = __atomic_load_n(&t->groupCount, __ATOMIC_RELAXED) + 1;
+        const struct group *g = __atomic_load_n(&table[hash & (buckets - 1)],
+                                                __ATOMIC_ACQUIRE);
+
+        // A found group is valid whatever the table does; it is never moved.
+        for (; g != NULL && steps-- > 0; g = __atomic_load_n(&g->next, __ATOMIC_ACQUIRE)) {
+            if (g->hash == hash && g->keyLength == length &&
+                memcmp(groupKey(g), key, length) == 0) {
+                return g;
+            }
+        }
+
+        // A miss only holds if no resize overlapped the walk.
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (g == NULL && (resizes & 1) == 0 &&
+            __atomic_load_n(&t->resizes, __ATOMIC_RELAXED) == resizes) {
+            return NULL;
+        }
+        sched_yield();
+    }
+}
+
+/* Registers a reader of 't'. Returns NULL on failure */
+TrackerReader *trackerReaderCreate (Tracker *t) {
+    TrackerReader *r;
+
+    if ((r = malloc(sizeof(TrackerReader))) == NULL) {
+        return NULL;
+    }
+    r->tracker = t;
+    if ((r->slot = epochRegister(t->epochs)) == -1) {
+        free(r);
+        return NULL;
+    }
+    return r;
+}
+
+/* Visits the files named 'fileName' as of one moment, newest first. Returns
+ * their count, or -1 if they couldn't be decoded and copied */
+long trackerReaderQuery (TrackerReader *r, const char *fileName, TrackerVisitor visit,
+                         void *context) {
+    Tracker *t = r->tracker;
+    char buffer[NAME_MAX + 1], path[MAX_PATH];
+    const struct group *g;
+    const char *key;
+    File *files = NULL;
+    uint32_t count = 0, copied = 0;
+    void *block = NULL;
+    int stopped = 0;
+
+    if ((key = makeKey(t->keyPolicy, fileName, buffer)) == NULL) {
+        return 0;
+    }
+    epochEnter(t->epochs, r->slot);
+
+    // A count and block read between two equal counts belong together.
+    if ((g = readGroup(t, key, strlen(key), trackerHash(key))) != NULL) {
+        do {
+            count = __atomic_load_n(&g->count, __ATOMIC_ACQUIRE);
+            block = __atomic_load_n(&g->members, __ATOMIC_ACQUIRE);
+        } while (__atomic_load_n(&g->count, __ATOMIC_ACQUIRE) != count);
+    }
+
+    // Copy the members out, so slow visits don't hold back reclamation.
+    if (visit != NULL && count > 0 && (files = malloc(count * sizeof(File))) != NULL) {
+        for (; copied < count; copied++) {
+            size_t length;
+            if (pathStoreGet(t->paths, blockPaths(block)[copied], path, &length) ||
+                (files[copied].filePath = malloc(length + 1)) == NULL) {
+                break;
+            }
+            memcpy(files[copied].filePath, path, length + 1);
+            files[copied].modified = blockTimes(block)[copied];
+            files[copied].size = blockSizes(block)[copied];
+        }
+    }
+    epochExit(t->epochs, r->slot);
+
+    if (copied > 0) {
+        qsort(files, copied, sizeof(File), compareNewest);
+    }
+    for (uint32_t i = 0; i < copied; i++) {
+        FileView view;
+        pathView(files[i].filePath, files[i].modified, files[i].size, &view);
+        stopped = stopped || visit(context, &view);
+        free(files[i].filePath);
+    }
+    free(files);
+    return visit != NULL && count > 0 && copied < count ? -1 : (long)count;
+}
+
+/* Returns the files and groups tracked so far */
+void trackerReaderCounts (const TrackerReader *r, long *files, long *groups) {
+    *files = __atomic_load_n(&r->tracker->fileCount, __ATOMIC_RELAXED);
+    *groups = __atomic_load_n(&r->tracker->groupCount, __ATOMIC_RELAXED);
+}
+
+/* Unregisters and frees a reader */
+void trackerReaderDestroy (TrackerReader *r) {
+    if (r != NULL) {
+        epochUnregister(r->tracker->epochs, r->slot);
+        free(r);
+    }
+}
+
+/* Visits every file, group by group. Returns 1 if a visit stopped it, -1 if a
+ * path couldn't be decoded */
+int trackerIterate (Tracker *t, TrackerVisitor visit, void *context) {
+    char path[MAX_PATH];
+    FileView view;
+
+    for (long i = 0; i < t->buckets; i++) {
+        for (struct group *g = t->table[i]; g != NULL; g = g->next) {
+            sortGroup(t, g);
+            for (uint32_t m = 0; m < g->count; m++) {
+                if (makeView(t, g, m, path, &view)) {
+                    return -1;
+                }
+                if (visit(context, &view)) {
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/* Positions 'it' before the first group passing 'filter' (may be NULL) */
+void trackerBegin (Tracker *t, const TrackerFilter *filter, TrackerIterator *it) {
+    // The path buffer is left alone: it is only read after being filled.
+    memset(it, 0, offsetof(TrackerIterator, path));
+    it->tracker = t;
+    it->bucket = -1;
+    it->endBucket = t->buckets;
+    if (filter != NULL) {
+        it->filter = *filter;
+    }
+}
+
+/* Positions 'it' before the group of 'fileName' only */
+void trackerBeginMatches (Tracker *t, const char *fileName, const TrackerFilter *filter,
+                          TrackerIterator *it) {
+    char buffer[NAME_MAX + 1];
+    const char *key;
+
+    trackerBegin(t, filter, it);
+    it->single = 1;
+    if ((key = makeKey(t->keyPolicy, fileName, buffer)) != NULL) {
+        it->group = findGroup(t, key, strlen(key), trackerHash(key));
+    }
+}
+
+/* Advances to the next group passing the filter. Returns 0 when exhausted */
+int trackerNextGroup (TrackerIterator *it, GroupView *group) {
+    long minCount = it->filter.minCount > 1 ? it->filter.minCount : 1;
+    KernelFilter filter = kernelFilter(&it->filter);
+    Tracker *t = it->tracker;
+    struct group *g = it->group;
+
+    for (;;) {
+
+        // A single group iterator yields its group once.
+        if (it->single) {
+            if (it->single++ > 1 || g == NULL) {
+                return 0;
+            }
+        } else {
+            for (g = g != NULL ? g->next : NULL; g == NULL && ++it->bucket < it->endBucket; ) {
+                g = t->table[it->bucket];
+            }
+            if (g == NULL) {
+                it->group = NULL;
+                return 0;
+            }
+        }
+        it->group = g;
+
+        // Count the members passing the filter (a straight pass over two arrays).
+        group->count = 0;
+        group->bytes = 0;
+        if (g->count < minCount) {
+            continue;
+        }
+        group->count = kernelCount((const int64_t *)memberTimes(g), memberSizes(g), g->count,
+                                   &filter, &group->bytes);
+        if (group->count >= minCount) {
+            sortGroup(t, g);
+            group->key = groupKey(g);
+            group->keyLength = g->keyLength;
+            it->member = 0;
+            it->selected = it->selectedCount = 0;
+            return 1;
+        }
+    }
+}
+
+/* Advances to the group's next passing member. Returns 0 when exhausted */
+int trackerNextMember (TrackerIterator *it, FileView *file) {
+    const struct group *g = it->group;
+
+    if (g == NULL) {
+        return 0;
+    }
+
+    // Select the passing members a chunk at a time, skipping undecodable paths.
+    do {
+        while (it->selected == it->selectedCount) {
+            KernelFilter filter = kernelFilter(&it->filter);
+            uint32_t end;
+            if (it->member >= g->count) {
+                return 0;
+            }
+            end = it->member + ITERATOR_CHUNK < g->count ? it->member + ITERATOR_CHUNK
+                                                         : g->count;
+            it->selectedCount = kernelCompact((const int64_t *)memberTimes(g), memberSizes(g),
+                                              it->member, end, &filter, it->chunk);
+            it->selected = 0;
+            it->member = end;
+        }
+    } while (makeView(it->tracker, g, it->chunk[it->selected++], it->path, file));
+    return 1;
+}
+
+/* Returns the total number of files in the tracker */
+long trackerFileCount (const Tracker *t) {
+    return t->fileCount;
+}
+
+/* Returns the number of distinct names (groups) in the tracker */
+long trackerGroupCount (const Tracker *t) {
+    return t->groupCount;
+}
+
+/* Returns the bytes of the tracked paths, and the bytes storing them */
+void trackerPathUsage (const Tracker *t, uint64_t *rawBytes, uint64_t *storedBytes) {
+    pathStoreUsage(t->paths, rawBytes, storedBytes);
+}
+
+/* Returns the current number of hash table buckets */
+long trackerBucketCount (const Tracker *t) {
+    return t->buckets;
+}
+
+/* Returns the key the tracker's policy makes of 'name', NULL if too long */
+const char *trackerKey (const Tracker *t, const char *name, char buffer[NAME_MAX + 1]) {
+    return makeKey(t->keyPolicy, name, buffer);
+}
+
+/* Prints tracked files passing 'filter' (may be NULL) grouped by name, newest first */
+void trackerPrint (Tracker *t, const TrackerFilter *filter, FILE *out) {
+    trackerPrintSorted(t, filter, ORDER_TABLE, out);
+}
+
+/* Prints like trackerPrint, with the groups in 'order'. Signals error with nonzero value */
+int trackerPrintSorted (Tracker *t, const TrackerFilter *filter, ReportOrder order,
+                        FILE *out) {
+    long runCount = order == ORDER_TABLE ? 0 : t->reportThreads;
+    SortRun *runs = NULL;
+    Report r = {.tracker = t, .filter = filter,
+                .chunks = (t->buckets + REPORT_CHUNK - 1) / REPORT_CHUNK};
+
+    // Sort the passing groups first, if asked to.
+    STAT_BEGIN(start);
+    if (runCount > 0) {
+        // sortGroups sets up every run, even when it fails.
+        if ((runs = allocate(t, MEM_CACHES, runCount * sizeof(SortRun))) == NULL ||
+            sortGroups(t, filter, order, runs, runCount)) {
+            for (long i = 0; runs != NULL && i < runCount; i++) {
+                freePairs(&runs[i]);
+            }
+            release(t, MEM_CACHES, runs, runCount * sizeof(SortRun));
+            return 1;
+        }
+        r.pairs = runs[0].pairs;
+        r.pairCount = runs[0].count;
+        r.sorted = 1;
+        r.chunks = (r.pairCount + REPORT_GROUPS - 1) / REPORT_GROUPS;
+    }
+
+    // Print each group of duplicate files.
+    printReport(&r, out);
+    STAT_END(PHASE_REPORT, start);
+
+    if (runs != NULL) {
+        freePairs(&runs[0]);
+        release(t, MEM_CACHES, runs, runCount * sizeof(SortRun));
+    }
+    return 0;
+}
+
+/* Prints the files named 'fileName' (or that there are none) */
+void trackerPrintMatches (Tracker *t, const char *fileName, FILE *out) {
+    TrackerIterator it;
+    GroupView group;
+    long bytes;
+
+    // Compute hash, search table.
+    STAT_BEGIN(start);
+    PROBE_REPORT_START();
+    trackerBeginMatches(t, fileName, NULL, &it);
+    if (!trackerNextGroup(&it, &group)) {
+        fprintf(out, "Sorry, no match found!\n");
+        PROBE_REPORT_DONE(0, 0);
+    } else {
+        bytes = printGroup(&it, &group, out);
+        PROBE_REPORT_DONE(1, bytes);
+    }
+    STAT_END(PHASE_REPORT, start);
+}
+
+/* Prints the bucket distribution of the table and of candidate replacements */
+void trackerDiagnostics (Tracker *t, FILE *out) {
+    KeyCount *keys;
+    long n = 0;
+
+    if ((keys = malloc((t->groupCount + 1) * sizeof(KeyCount))) == NULL) {
+        fprintf(stderr, "Error: Can't compute table diagnostics!\n");
+        return;
+    }
+    for (long i = 0; i < t->buckets; i++) {
+        for (struct group *g = t->table[i]; g != NULL; g = g->next) {
+            keys[n].name = groupKey(g);
+            keys[n++].count = g->count;
+        }
+    }
+
+    fprintf(out, "Diagnostics: %ld files, %ld distinct names\n", t->fileCount, n);
+    printDistribution(out, "current: fnv1a-64 & mask", keys, n, t->fileCount,
+                      t->buckets, currentBucket);
+    printDistribution(out, "candidate: fnv1a-64 & mask, twice the buckets", keys, n,
+                      t->fileCount, 2 * t->buckets, currentBucket);
+    printDistribution(out, "previous: fnv1a % fixed size", keys, n, t->fileCount,
+                      LEGACY_SIZE, legacyBucket);
+
+    free(keys);
+}
+
+/* Writes the tracker to an index file. Signals error with nonzero value */
+int trackerSave (Tracker *t, const char *indexPath) {
+    IndexHeader header = {INDEX_MAGIC, INDEX_VERSION, 0, 0};
+    char path[MAX_PATH];
+    struct group **groups;
+    FILE *index;
+    int status = 0;
+
+    if ((groups = allGroups(t)) == NULL) {
+        return 1;
+    }
+    if ((index = fopen(indexPath, "wb")) == NULL) {
+        free(groups);
+        return 1;
+    }
+
+    // Records are key ordered so indexes can be merged and compared in one pass.
+    qsort(groups, t->groupCount, sizeof(struct group *), compareGroups);
+    header.keyPolicy = t->keyPolicy;
+    header.count = t->fileCount;
+    status |= fwrite(&header, sizeof(header), 1, index) != 1;
+
+    for (long i = 0; i < t->groupCount && status == 0; i++) {
+        struct group *g = groups[i];
+        sortGroup(t, g);
+        for (uint32_t m = 0; m < g->count && status == 0; m++) {
+            File file = {path, memberTimes(g)[m], memberSizes(g)[m]};
+            status = pathStoreGet(t->paths, memberPaths(g)[m], path, NULL) ||
+                     writeRecord(index, &file);
+        }
+    }
+
+    free(groups);
+    return (fclose(index) != 0) | status;
+}
+
+/* Tracks every file in an index file. Signals error with nonzero value */
+int trackerLoad (Tracker *t, const char *indexPath) {
+    IndexCursor cursor;
+    int status;
+
+    if (openCursor(&cursor, indexPath)) {
+        return 1;
+    }
+    while ((status = advanceCursor(&cursor)) == 1) {
+        if (trackerInsert(t, cursor.file.filePath, cursor.file.modified, cursor.file.size)) {
+            status = -1;
+            break;
+        }
+    }
+
+    closeCursor(&cursor);
+    return status != 0;
+}
+
+/* Merges name-sorted index files into one. Signals error with nonzero value */
+int trackerMergeIndexes (const char *outputPath, const char * const *inputPaths, long count) {
+    IndexHeader header = {INDEX_MAGIC, INDEX_VERSION, 0, 0};
+    IndexCursor *cursors;
+    long *heap, size = 0, opened;
+    FILE *output = NULL;
+    struct stat outputStat, inputStat;
+    int status = 0;
+
+    // The output is truncated while the inputs are mapped, so it can't be one of them.
+    if (stat(outputPath, &outputStat) == 0) {
+        for (long i = 0; i < count; i++) {
+            if (stat(inputPaths[i], &inputStat) == 0 && inputStat.st_dev == outputStat.st_dev &&
+                inputStat.st_ino == outputStat.st_ino) {
+                return 1;
+            }
+        }
+    }
+    if ((cursors = malloc(count * sizeof(IndexCursor))) == NULL ||
+        (heap = malloc(count * sizeof(long))) == NULL) {
+        free(cursors);
+        return 1;
+    }
+
+    // Open every input; they must agree on the key policy.
+    for (opened = 0; opened < count && status == 0; opened++) {
+        if (openCursor(&cursors[opened], inputPaths[opened])) {
+            status = 1;
+            break;
+        }
+        header.keyPolicy = cursors[0].header.keyPolicy;
+        header.count += cursors[opened].header.count;
+        status = cursors[opened].header.keyPolicy != header.keyPolicy;
+    }
+    if (status == 0 && (output = fopen(outputPath, "wb")) == NULL) {
+        status = 1;
+    }
+    if (status == 0) {
+        setvbuf(output, NULL, _IOFBF, MERGE_BUFFER);
+        status = fwrite(&header, sizeof(header), 1, output) != 1;
+    }
+
+    // Prime a min-heap with each input's first record.
+    for (long i = 0; i < count && status == 0; i++) {
+        int read = advanceCursor(&cursors[i]);
+        if (read == 1) {
+            heap[size++] = i;
+            siftUp(cursors, heap, size - 1);
+        } else {
+            status = read != 0;
+        }
+    }
+
+    // Emit the least record and replace it with its input's next.
+    while (size > 0 && status == 0) {
+        IndexCursor *c = &cursors[heap[0]];
+        int read;
+
+        if ((status = writeRecord(output, &c->file)) != 0 ||
+            (read = advanceCursor(c)) == -1) {
+            status = 1;
+            break;
+        }
+        if (read == 0) {
+            heap[0] = heap[--size];
+        }
+        siftDown(cursors, heap, size, 0);
+    }
+
+    for (long i = 0; i < opened; i++) {
+        closeCursor(&cursors[i]);
+    }
+    if (output != NULL) {
+        status |= fclose(output) != 0;
+    }
+    free(cursors);
+    free(heap);
+    return status;
+}
+
+/* Prints how duplicate groups changed between two indexes. Signals error with nonzero value */
+int trackerDiffIndexes (const char *beforePath, const char *afterPath, FILE *out) {
+    static const char *labels[DELTA_KINDS] = {"new", "resolved", "grown", "shrunk"};
+    IndexCursor before, after;
+    IndexGroup old, new;
+    int oldPending = 0, newPending = 0, oldRead, newRead, status = 0;
+    long totals[DELTA_KINDS] = {0};
+
+    if (openCursor(&before, beforePath)) {
+        return 1;
+    }
+    if (openCursor(&after, afterPath)) {
+        closeCursor(&before);
+        return 1;
+    }
+    if (before.header.keyPolicy != after.header.keyPolicy) {
+        status = 1;
+    }
+
+    // Walk both key-ordered group sequences together; a missing key has no files.
+    oldRead = status ? 0 : nextIndexGroup(&before, &oldPending, &old);
+    newRead = status ? 0 : nextIndexGroup(&after, &newPending, &new);
+    while ((oldRead == 1 || newRead == 1) && oldRead != -1 && newRead != -1) {
+        int order = oldRead != 1 ? 1 : newRead != 1 ? -1 : strcmp(old.key, new.key);
+        long oldCount = order <= 0 ? old.count : 0, newCount = order >= 0 ? new.count : 0;
+        uint64_t oldBytes = order <= 0 ? old.bytes : 0, newBytes = order >= 0 ? new.bytes : 0;
+        int kind = deltaKind(oldCount, newCount);
+
+        if (kind != -1) {
+            totals[kind]++;
+            fprintf(out, "%-9s %-40s %5ld -> %-5ld files %+14lld bytes\n", labels[kind],
+                    order <= 0 ? old.key : new.key, oldCount, newCount,
+                    (long long)(newBytes - oldBytes));
+        }
+        if (order <= 0) {
+            oldRead = nextIndexGroup(&before, &oldPending, &old);
+        }
+        if (order >= 0) {
+            newRead = nextIndexGroup(&after, &newPending, &new);
+        }
+    }
+    status |= oldRead == -1 || newRead == -1;
+
+    fprintf(out, "Diff: %ld new, %ld resolved, %ld grown, %ld shrunk duplicate groups\n",
+            totals[DELTA_NEW], totals[DELTA_RESOLVED], totals[DELTA_GROWN], totals[DELTA_SHRUNK]);
+    closeCursor(&before);
+    closeCursor(&after);
+    return status;
+}
+
+/* Free's the tracker (and all files) */
+void trackerDestroy (Tracker *t) {
+    if (t == NULL) {
+        return;
+    }
+
+    // Free the retired blocks, then all groups.
+    epochDestroy(t->epochs);
+    for (long i = 0; i < t->buckets; i++) {
+        struct group *g, *next;
+        for (g = t->table[i]; g != NULL; g = next) {
+            next = g->next;
+            if (g->members != NULL) {
+                release(t, MEM_NODES, g->members, memberBytes(g->capacity));
+            }
+            if (g->keyLength > KEY_INLINE) {
+                release(t, MEM_GROUPS, g->key.external, g->keyLength + 1);
+            }
+            release(t, MEM_GROUPS, g, sizeof(struct group));
+        }
+    }
+
+    // Free the paths, the table, then the handle.
+    pathStoreDestroy(t->paths);
+    release(t, MEM_TABLE, t->table, t->buckets * sizeof(struct group *));
+    release(t, MEM_TABLE, t, sizeof(Tracker));
 }
@@ -1,6 +1,6 @@
 /*
 ********************************************************************************
-*                                
+*
 * Filename     : duplicateTracker.h
 * Programmer(s): Owatch
 * Created      : 2017/08/29
@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <math.h>
 #include <time.h>
+#include <stdint.h>
 
 #if !defined(duplicateTracker_h)
 #define duplicateTracker_h
@@ -29,28 +30,247 @@
 /* The maximum length of a filepath */
 #define MAX_PATH    4096
 
+/* Opaque tracker handle. Trackers are independent; one per thread at a time
+ * (but see TrackerReader) */
+typedef struct tracker Tracker;
+
+/* Opaque handle of a thread querying a tracker while another fills it */
+typedef struct trackerReader TrackerReader;
+
+/* How file names are turned into grouping keys */
+typedef enum {
+    KEY_EXACT,          // Byte-wise equal names are duplicates.
+    KEY_IGNORE_CASE     // Names equal up to ASCII case are duplicates.
+} KeyPolicy;
+
+/* Memory supplier. 'size' is passed back on release for sized allocators */
+typedef struct {
+    void *(*allocate)(void *context, size_t size);
+    void (*release)(void *context, void *p, size_t size);
+    void *context;
+} TrackerAllocator;
+
+/* View of a tracked file. Paths are decoded on demand, so a view is valid until
+ * the visit returns or the iterator advances (and until the tracker changes) */
+typedef struct {
+    const char *path;           // Full path, NUL terminated.
+    const char *directory;      // Directory part (not terminated), may be empty.
+    size_t directoryLength;
+    const char *name;           // File name, NUL terminated.
+    size_t nameLength;
+    time_t modified;
+    uint64_t size;
+} FileView;
+
+/* Called from the inserting thread for each file of a group that holds
+ * duplicates: for the first two when the second arrives, then for each one
+ * added. 'count' is the group's size so far */
+typedef void (*TrackerStream)(void *context, const char *key, long count,
+                              const FileView *file);
+
+/* Tracker settings (zero-initialized fields take defaults) */
+typedef struct {
+    long initialBuckets;                // Rounded up to a power of two.
+    KeyPolicy keyPolicy;
+    const TrackerAllocator *allocator;  // NULL: malloc, with memory accounting.
+    int reportThreads;                  // Report workers. Default: one per online
+                                        // CPU (one with a user allocator).
+    TrackerStream stream;               // Duplicates as they are found (optional).
+    void *streamContext;
+} TrackerConfig;
+
+/* Zero-copy view of a group of files sharing a key */
+typedef struct {
+    const char *key;            // Grouping key, NUL terminated.
+    size_t keyLength;
+    long count;                 // Members passing the filter.
+    uint64_t bytes;             // Their total size.
+} GroupView;
+
+/* A file with its key computed by trackerPrepare (pointers are the caller's) */
+typedef struct {
+    const char *path;
+    size_t pathLength;
+    const char *key;            // The normalised name.
+    size_t keyLength;
+    uint64_t hash;
+    time_t modified;
+    uint64_t size;
+} TrackerRecord;
+
+/* Order of the groups in a report */
+typedef enum {
+    ORDER_TABLE,        // Hash table order (fastest).
+    ORDER_NAME,         // By name.
+    ORDER_COUNT,        // Most copies first.
+    ORDER_WASTED,       // Most bytes in copies other than the newest first.
+    ORDER_NEWEST        // Most recently modified newest copy first.
+} ReportOrder;
+
+/* Filter applied while iterating (zero fields don't filter) */
+typedef struct {
+    long minCount;              // Skip groups with fewer passing members.
+    uint64_t minSize;           // Skip members smaller than this.
+    time_t from, to;            // Skip members modified outside [from, to].
+} TrackerFilter;
+
+/* Members an iterator selects at a time */
+#define ITERATOR_CHUNK  64
+
+/* Iterator state (fields are private) */
+typedef struct {
+    Tracker *tracker;
+    TrackerFilter filter;
+    long bucket, endBucket;
+    void *group;
+    uint32_t member;            // First member not yet selected.
+    uint32_t selected, selectedCount;
+    int single;
+    uint32_t chunk[ITERATOR_CHUNK];     // Indices of selected members.
+    char path[MAX_PATH];        // The current member's decoded path.
+} TrackerIterator;
+
+/* Called per file; a nonzero return stops the walk */
+typedef int (*TrackerVisitor)(void *context, const FileView *file);
+
 /*
  ******************************************************************************
  *                                  Prototypes
  ******************************************************************************
  */
 
- /* Hashes and logs the given file details */
- int trackFile (const char *filePath, const time_t modified);
+ /* Creates a tracker ('config' may be NULL). Returns NULL on failure */
+ Tracker *trackerCreate (const TrackerConfig *config);
+
+ /* Hashes and logs the given file details. Signals error with nonzero value */
+ int trackerInsert (Tracker *t, const char *filePath, time_t modified, uint64_t size);
+
+ /*
+  * Sets the key and hash of 'record' from its path. Keys that differ from the
+  * file name are written to 'buffer'. Only reads the key policy, so any thread
+  * may prepare records while another inserts. Signals error with nonzero value.
+  */
+ int trackerPrepare (const Tracker *t, TrackerRecord *record, char buffer[NAME_MAX + 1]);
+
+ /* Tracks a prepared record. Signals error with nonzero value */
+ int trackerInsertPrepared (Tracker *t, const TrackerRecord *record);
+
+ /*
+  * Tracks 'count' prepared records in one merge: they are partitioned by table
+  * region, radix-style, and inserted region by region with the table slots and
+  * chains fetched ahead. Threads filling their own record buffers can share a
+  * tracker by taking a lock per batch. Returns the number of records that
+  * couldn't be tracked (the others are).
+  */
+ long trackerInsertBatch (Tracker *t, const TrackerRecord *records, long count);
+
+ /* Visits the files named 'fileName', newest first. Returns their count, or -1
+  * if a path couldn't be decoded */
+ long trackerQuery (Tracker *t, const char *fileName, TrackerVisitor visit,
+                    void *context);
+
+ /*
+  * Registers a reader of 't' for use by one other thread. Readers take no locks
+  * and never block the inserting thread: they see groups and members as they
+  * are published, and memory the tracker replaces outlives their queries.
+  * Returns NULL on failure (at most EPOCH_READERS, 64, at once).
+  */
+ TrackerReader *trackerReaderCreate (Tracker *t);
+
+ /*
+  * Visits the files named 'fileName', newest first, as of one moment during
+  * the query (visits run on a copy). Returns their count, or -1 if they
+  * couldn't be decoded and copied.
+  */
+ long trackerReaderQuery (TrackerReader *r, const char *fileName, TrackerVisitor visit,
+                          void *context);
+
+ /* Returns the files and groups tracked so far */
+ void trackerReaderCounts (const TrackerReader *r, long *files, long *groups);
+
+ /* Unregisters and frees a reader (before the tracker is destroyed) */
+ void trackerReaderDestroy (TrackerReader *r);
+
+ /* Visits every file, group by group. Returns 1 if a visit stopped it, -1 if a
+  * path couldn't be decoded */
+ int trackerIterate (Tracker *t, TrackerVisitor visit, void *context);
+
+ /* Positions 'it' before the first group passing 'filter' (may be NULL) */
+ void trackerBegin (Tracker *t, const TrackerFilter *filter, TrackerIterator *it);
+
+ /* Positions 'it' before the group of 'fileName' only */
+ void trackerBeginMatches (Tracker *t, const char *fileName, const TrackerFilter *filter,
+                           TrackerIterator *it);
+
+ /* Advances to the next group passing the filter. Returns 0 when exhausted */
+ int trackerNextGroup (TrackerIterator *it, GroupView *group);
+
+ /* Advances to the group's next passing member (skipping any whose path can't
+  * be decoded). Returns 0 when exhausted */
+ int trackerNextMember (TrackerIterator *it, FileView *file);
+
+ /* Returns the total number of files in the tracker */
+ long trackerFileCount (const Tracker *t);
+
+ /* Returns the number of distinct names (groups) in the tracker */
+ long trackerGroupCount (const Tracker *t);
+
+ /* Returns the bytes of the tracked paths, and the bytes storing them */
+ void trackerPathUsage (const Tracker *t, uint64_t *rawBytes, uint64_t *storedBytes);
+
+ /* Returns the current number of hash table buckets */
+ long trackerBucketCount (const Tracker *t);
+
+ /* Returns the hash the tracker computes for a (normalised) key */
+ uint64_t trackerHash (const char *key);
+
+ /* Returns the key the tracker's policy makes of 'name' (written to 'buffer' if
+  * it differs), or NULL if the name is too long */
+ const char *trackerKey (const Tracker *t, const char *name, char buffer[NAME_MAX + 1]);
+
+ /*
+  * Prints tracked files passing 'filter' (may be NULL) grouped by name, newest
+  * first. Report workers format ranges of the table in parallel; the output is
+  * the same for any number of them.
+  */
+ void trackerPrint (Tracker *t, const TrackerFilter *filter, FILE *out);
+
+ /*
+  * Prints like trackerPrint, with the groups in 'order' (ties by name). The
+  * report workers also sort (key, group) pairs in parallel. Signals error with
+  * nonzero value, before printing anything.
+  */
+ int trackerPrintSorted (Tracker *t, const TrackerFilter *filter, ReportOrder order,
+                         FILE *out);
+
+ /* Prints the files named 'fileName' (or that there are none) */
+ void trackerPrintMatches (Tracker *t, const char *fileName, FILE *out);
+
+ /* Prints the bucket distribution of the table and of candidate replacements */
+ void trackerDiagnostics (Tracker *t, FILE *out);
 
- /* Initializes the internal file table */
- int initializeFileTable (void);
+ /* Writes the tracker to an index file. Signals error with nonzero value */
+ int trackerSave (Tracker *t, const char *indexPath);
 
- /* Prints all duplicate files logged in the file table by desc modified date */
- void printFileTable (void);
+ /* Tracks every file in an index file. Signals error with nonzero value */
+ int trackerLoad (Tracker *t, const char *indexPath);
 
- /* Searches the file table for a particular file name. Then prints results */
- void findFile (const char *fileName);
+ /*
+  * Merges index files (each ordered by name, as saved) into 'outputPath' in one
+  * streaming pass, holding one record per input. They must share a key policy,
+  * and the output can't be one of them. Signals error with nonzero value.
+  */
+ int trackerMergeIndexes (const char *outputPath, const char * const *inputPaths,
+                          long count);
 
- /* Returns the total number of files in the file table */
- long getFileCount (void);
+ /*
+  * Prints the duplicate groups that are new, resolved, grown or shrunk in index
+  * 'afterPath' relative to 'beforePath', in one pass over both mapped files.
+  * Signals error with nonzero value.
+  */
+ int trackerDiffIndexes (const char *beforePath, const char *afterPath, FILE *out);
 
- /* Free's the internal file table (and all files) */
- int freeFileTable (void);
+ /* Free's the tracker (and all files) */
+ void trackerDestroy (Tracker *t);
 
-#endif
\ No newline at end of file
+#endif